@@ -186,3 +186,40 @@ API_EXPORT void request_stop(void* ptr)
 {
     sim(ptr)->request_stop();
 }
+
+API_EXPORT uint64_t step_ticks(void* ptr, uint64_t tick_count)
+{
+    return sim(ptr)->step_ticks(tick_count);
+}
+
+API_EXPORT void run_until_tick(void* ptr, uint64_t tick)
+{
+    sim(ptr)->run_until_tick(tick);
+}
+
+API_EXPORT void set_tick_event_callback_interval(void* ptr, uint64_t interval)
+{
+    sim(ptr)->set_tick_event_callback_interval(interval);
+}
+
+API_EXPORT void set_snapshot_reads(void* ptr, int enabled)
+{
+    sim(ptr)->set_snapshot_reads(enabled != 0);
+}
+
+API_EXPORT void set_position_frames(void* ptr, int enabled)
+{
+    sim(ptr)->set_position_frames(enabled != 0);
+}
+
+// NOTE: The frame remains valid until the next call to get_position_frame.
+// Only one thread may consume position frames at a time.
+API_EXPORT const PositionFrameView* get_position_frame(void* ptr)
+{
+    return sim(ptr)->get_position_frame();
+}
+
+API_EXPORT void set_worker_threads(void* ptr, uint64_t thread_count)
+{
+    sim(ptr)->set_worker_threads(thread_count);
+}
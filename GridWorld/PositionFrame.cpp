@@ -0,0 +1,57 @@
+#include "stdafx.h"
+#include "PositionFrame.h"
+#include "components.h"
+
+using namespace GridWorld;
+using namespace GridWorld::Component;
+
+void GridWorld::PositionFrame::write(registry const& reg)
+{
+    // Entities are listed in row-major order of their tiles, straight from the map
+    eids.clear();
+    x.clear();
+    y.clear();
+    types.clear();
+
+    reg.ctx<SWorld>().for_each_tile_row_major([this, &reg](int tile_x, int tile_y, EntityId eid)
+    {
+        eids.push_back(to_integral(eid));
+        x.push_back(tile_x);
+        y.push_back(tile_y);
+        types.push_back(
+            POSITION_FRAME_PREDATOR * reg.has<Predation>(eid)
+            | POSITION_FRAME_SCORABLE * reg.has<Scorable>(eid));
+    });
+
+    const size_t count = eids.size();
+
+    view.tick = reg.ctx<STickCounter>().tick;
+    view.count = count;
+    view.eids = eids.data();
+    view.x = x.data();
+    view.y = y.data();
+    view.types = types.data();
+}
+
+PositionFrame& GridWorld::PositionFrameBuffer::back()
+{
+    return frames[back_index];
+}
+
+void GridWorld::PositionFrameBuffer::publish()
+{
+    // Swap the finished back frame into the middle slot, and take the old middle as the new back.
+    uint8_t previous = middle_state.exchange(back_index | fresh_bit, std::memory_order_acq_rel);
+    back_index = previous & index_mask;
+}
+
+const PositionFrameView* GridWorld::PositionFrameBuffer::acquire()
+{
+    if (middle_state.load(std::memory_order_relaxed) & fresh_bit)
+    {
+        uint8_t previous = middle_state.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & index_mask;
+    }
+
+    return &frames[front_index].view;
+}
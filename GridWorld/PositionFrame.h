@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include "Registry.h"
+
+namespace GridWorld
+{
+    enum PositionFrameTypeFlags : uint8_t
+    {
+        POSITION_FRAME_PREDATOR = 1 << 0,
+        POSITION_FRAME_SCORABLE = 1 << 1
+    };
+
+    /*
+    C compatible view of a position frame. Entity i is at (x[i], y[i]),
+    with its PositionFrameTypeFlags in types[i]. Entities are ordered row-major by position.
+    */
+    struct PositionFrameView
+    {
+        uint64_t tick = 0;
+        uint64_t count = 0;
+        const uint64_t* eids = nullptr;
+        const int32_t* x = nullptr;
+        const int32_t* y = nullptr;
+        const uint8_t* types = nullptr;
+    };
+
+    struct PositionFrame
+    {
+        std::vector<uint64_t> eids;
+        std::vector<int32_t> x;
+        std::vector<int32_t> y;
+        std::vector<uint8_t> types;
+        PositionFrameView view;
+
+        void write(registry const& reg);
+    };
+
+    /*
+    Lock-free triple buffer of position frames, for one writer and one reader.
+    The writer fills back() and publishes it, the reader acquires the latest published frame.
+    Neither side ever waits for the other.
+    */
+    class PositionFrameBuffer
+    {
+    public:
+        PositionFrame& back();
+
+        void publish();
+
+        // The returned frame stays valid and unchanged until the next call to acquire.
+        const PositionFrameView* acquire();
+    private:
+        static constexpr uint8_t index_mask = 0b011;
+        static constexpr uint8_t fresh_bit = 0b100;
+
+        PositionFrame frames[3];
+        uint8_t back_index = 0;
+        std::atomic<uint8_t> middle_state = 1;
+        uint8_t front_index = 2;
+    };
+}
@@ -7,8 +7,10 @@
 #include <rapidjson/schema.h>
 #include <condition_variable>
 #include <unordered_map>
+#include <unordered_set>
 #include <charconv>
 #include <random>
+#include <optional>
 
 #include "Simulation.h"
 #include "components.h"
@@ -46,6 +48,43 @@ private:
     std::shared_mutex& shared_mutex;
 };
 
+/*
+Grants read access to the simulation state.
+If a published snapshot is provided, the snapshot is read and the simulation is never paused.
+Otherwise the live registry is read under a shared_pause_lock.
+*/
+class state_read_lock
+{
+public:
+    state_read_lock(std::shared_ptr<const GridWorld::registry> snapshot,
+        const GridWorld::registry& live_reg,
+        std::atomic<uint32_t>& pause_requests,
+        std::condition_variable_any& no_pauses_requested,
+        std::shared_mutex& shared_mutex) :
+        snapshot(std::move(snapshot)),
+        live_reg(live_reg)
+    {
+        if (this->snapshot == nullptr)
+        {
+            pause_lock.emplace(pause_requests, no_pauses_requested, shared_mutex);
+        }
+    }
+
+    const GridWorld::registry& state() const
+    {
+        return snapshot != nullptr ? *snapshot : live_reg;
+    }
+
+    uint64_t tick() const
+    {
+        return state().ctx<GridWorld::Component::STickCounter>().tick;
+    }
+private:
+    std::shared_ptr<const GridWorld::registry> snapshot;
+    const GridWorld::registry& live_reg;
+    std::optional<shared_pause_lock> pause_lock;
+};
+
 namespace Reflect
 {
     using namespace GridWorld::Component;
@@ -64,6 +103,7 @@ namespace Reflect
     REFLECT_COM_NAME(RNG);
     REFLECT_COM_NAME(SimpleBrain);
     REFLECT_COM_NAME(SimpleBrainSeer);
+    REFLECT_COM_NAME(SimpleBrainSectorSeer);
     REFLECT_COM_NAME(SimpleBrainMover);
     REFLECT_COM_NAME(Predation);
     REFLECT_COM_NAME(RandomMover);
@@ -88,12 +128,19 @@ namespace Reflect
         id_name_pair<RNG>(),
         id_name_pair<SimpleBrain>(),
         id_name_pair<SimpleBrainSeer>(),
+        id_name_pair<SimpleBrainSectorSeer>(),
         id_name_pair<SimpleBrainMover>(),
         id_name_pair<Predation>(),
         id_name_pair<RandomMover>(),
         id_name_pair<Scorable>()
     };
 
+    // Components the systems keep to themselves, which have no name and are never exposed.
+    static const std::unordered_set<ENTT_ID_TYPE> transient_com_ids
+    {
+        entt::type_info<SimpleBrainCache>::id()
+    };
+
     const char* id_to_com_name(ENTT_ID_TYPE id)
     {
         return com_id_name_map.at(id);
@@ -128,6 +175,8 @@ namespace GridWorld::JSON
         writer.Uint(com.evo_winner_count);
         writer.Key("evo_new_entity_count");
         writer.Uint(com.evo_new_entity_count);
+        writer.Key("quantized_brains");
+        writer.Bool(com.quantized_brains);
 
         writer.EndObject();
     }
@@ -137,6 +186,7 @@ namespace GridWorld::JSON
         com.evo_ticks_per_evolution = value["evo_ticks_per_evolution"].GetUint();
         com.evo_winner_count = value["evo_winner_count"].GetUint();
         com.evo_new_entity_count = value["evo_new_entity_count"].GetUint();
+        com.quantized_brains = value.HasMember("quantized_brains") && value["quantized_brains"].GetBool();
     }
 
     void json_write(STickCounter const& com, Writer<StringBuffer>& writer)
@@ -157,6 +207,10 @@ namespace GridWorld::JSON
         writer.Int(com.width);
         writer.Key("height");
         writer.Int(com.height);
+        writer.Key("tiled_layout");
+        writer.Bool(com.use_tiled_layout);
+        writer.Key("sparse_layout");
+        writer.Bool(com.use_sparse_layout);
 
         writer.EndObject();
     }
@@ -165,6 +219,8 @@ namespace GridWorld::JSON
     {
         com.width = value["width"].GetInt();
         com.height = value["height"].GetInt();
+        com.use_tiled_layout = value.HasMember("tiled_layout") && value["tiled_layout"].GetBool();
+        com.use_sparse_layout = value.HasMember("sparse_layout") && value["sparse_layout"].GetBool();
         com.reset_world();
     }
 
@@ -276,6 +332,24 @@ namespace GridWorld::JSON
         com.sight_radius = value["sight_radius"].GetInt();
     }
 
+    void json_write(SimpleBrainSectorSeer const& seer, Writer<StringBuffer>& writer)
+    {
+        writer.StartObject();
+
+        writer.Key("neuron_offset");
+        writer.Int(seer.neuron_offset);
+        writer.Key("sight_radius");
+        writer.Int(seer.sight_radius);
+
+        writer.EndObject();
+    }
+
+    void json_read(SimpleBrainSectorSeer& com, Value const& value)
+    {
+        com.neuron_offset = value["neuron_offset"].GetInt();
+        com.sight_radius = value["sight_radius"].GetInt();
+    }
+
     void json_write(SimpleBrainMover const& mover, Writer<StringBuffer>& writer)
     {
         writer.StartObject();
@@ -345,30 +419,6 @@ namespace GridWorld::JSON
         }
     }
 
-    void json_write(NeuronMat const& mat, Writer<StringBuffer>& writer)
-    {
-        writer.StartArray();
-
-        for (int c = 0; c < mat.cols(); c++)
-        {
-            writer.Double(mat(c));
-        }
-
-        writer.EndArray();
-    }
-
-    void json_read(NeuronMat& com, Value const& value)
-    {
-        int cols = value.Size();
-
-        com.resize(cols);
-
-        for (int c = 0; c < cols; c++)
-        {
-            com(c) = (float)value[c].GetDouble();
-        }
-    }
-
     void json_write(SimpleBrain const& com, Writer<StringBuffer>& writer)
     {
         writer.StartObject();
@@ -379,8 +429,6 @@ namespace GridWorld::JSON
         writer.Double(com.child_mutation_strength);
         writer.Key("synapses");
         json_write(com.synapses, writer);
-        writer.Key("neurons");
-        json_write(com.neurons, writer);
 
         writer.EndObject();
     }
@@ -390,7 +438,7 @@ namespace GridWorld::JSON
         com.child_mutation_chance = (float)value["child_mutation_chance"].GetDouble();
         com.child_mutation_strength = (float)value["child_mutation_strength"].GetDouble();
         json_read(com.synapses, value["synapses"]);
-        json_read(com.neurons, value["neurons"]);
+        // Older states also hold "neurons", which are transient now and left to the brain systems
     }
 
     void json_write(Scorable const& scorable, Writer<StringBuffer>& writer)
@@ -621,6 +669,17 @@ namespace GridWorld::Binary
     using namespace GridWorld::Component;
     using buffer = std::vector<char>;
 
+    /*
+    Binary states start with state_format_marker followed by the format version they were saved in. States saved
+    before the format was versioned start with their entity count instead, which can never equal the marker;
+    they are read as version 0. Types whose layout changed take the version to read.
+    Version 1: SWorld stores its tiled and sparse layout flags, SSimulationConfig stores quantized_brains,
+    and SimpleBrainSectorSeer components are stored after SimpleBrainSeer.
+    Version 2: SimpleBrain no longer stores its neurons.
+    */
+    constexpr uint64_t state_format_marker = UINT64_MAX;
+    constexpr uint32_t state_format_version = 2;
+
     template<class T>
     void push_into_buffer(buffer& buf, const T& obj);
 
@@ -685,18 +744,52 @@ namespace GridWorld::Binary
         return offset + count;
     }
 
+    void push_into_buffer(buffer& buf, const SSimulationConfig& obj)
+    {
+        push_into_buffer(buf, obj.evo_ticks_per_evolution);
+        push_into_buffer(buf, obj.evo_winner_count);
+        push_into_buffer(buf, obj.evo_new_entity_count);
+        push_into_buffer(buf, obj.quantized_brains);
+    }
+
+    size_t copy_from_buffer(const char* buf, const char* buf_end, SSimulationConfig& obj, uint32_t version)
+    {
+        size_t offset = 0;
+        offset += copy_from_buffer(buf + offset, buf_end, obj.evo_ticks_per_evolution);
+        offset += copy_from_buffer(buf + offset, buf_end, obj.evo_winner_count);
+        offset += copy_from_buffer(buf + offset, buf_end, obj.evo_new_entity_count);
+
+        obj.quantized_brains = false;
+        if (version >= 1)
+        {
+            offset += copy_from_buffer(buf + offset, buf_end, obj.quantized_brains);
+        }
+
+        return offset;
+    }
+
     void push_into_buffer(buffer& buf, const SWorld& obj)
     {
         push_into_buffer(buf, obj.width);
         push_into_buffer(buf, obj.height);
+        push_into_buffer(buf, obj.use_tiled_layout);
+        push_into_buffer(buf, obj.use_sparse_layout);
     }
 
-    size_t copy_from_buffer(const char* buf, const char* buf_end, SWorld& obj)
+    size_t copy_from_buffer(const char* buf, const char* buf_end, SWorld& obj, uint32_t version)
     {
         size_t offset = 0;
         offset += copy_from_buffer(buf + offset, buf_end, obj.width);
         offset += copy_from_buffer(buf + offset, buf_end, obj.height);
 
+        obj.use_tiled_layout = false;
+        obj.use_sparse_layout = false;
+        if (version >= 1)
+        {
+            offset += copy_from_buffer(buf + offset, buf_end, obj.use_tiled_layout);
+            offset += copy_from_buffer(buf + offset, buf_end, obj.use_sparse_layout);
+        }
+
         return offset;
     }
 
@@ -850,12 +943,6 @@ namespace GridWorld::Binary
         return offset;
     }
 
-    void push_into_buffer(buffer& buf, const NeuronMat& obj)
-    {
-        push_into_buffer(buf, obj.cols());
-        push_into_buffer(buf, obj.data(), obj.size());
-    }
-
     size_t copy_from_buffer(const char* buf, const char* buf_end, NeuronMat& obj)
     {
         size_t offset = 0;
@@ -871,16 +958,22 @@ namespace GridWorld::Binary
         push_into_buffer(buf, obj.child_mutation_chance);
         push_into_buffer(buf, obj.child_mutation_strength);
         push_into_buffer(buf, obj.synapses);
-        push_into_buffer(buf, obj.neurons);
     }
 
-    size_t copy_from_buffer(const char* buf, const char* buf_end, SimpleBrain& obj)
+    size_t copy_from_buffer(const char* buf, const char* buf_end, SimpleBrain& obj, uint32_t version)
     {
         size_t offset = 0;
         offset += copy_from_buffer(buf + offset, buf_end, obj.child_mutation_chance);
         offset += copy_from_buffer(buf + offset, buf_end, obj.child_mutation_strength);
         offset += copy_from_buffer(buf + offset, buf_end, obj.synapses);
-        offset += copy_from_buffer(buf + offset, buf_end, obj.neurons);
+
+        if (version < 2)
+        {
+            // The neurons are transient now, and left to the brain systems
+            std::vector<NeuronMat> neurons;
+            offset += copy_from_buffer(buf + offset, buf_end, neurons);
+        }
+
         return offset;
     }
 
@@ -912,7 +1005,7 @@ namespace GridWorld::Binary
         size_t count = 0;
         offset += copy_from_buffer(buf + offset, buf_end, count);
 
-        for (int i = 0; i < count; ++i)
+        for (size_t i = 0; i < count; ++i)
         {
             EntityId eid;
             offset += copy_from_buffer(buf + offset, buf_end, eid);
@@ -924,6 +1017,30 @@ namespace GridWorld::Binary
         return offset;
     }
 
+    // Same as above, for components read as laid out in the given format version.
+    template<class C>
+    size_t copy_components_from_buffer(const char* buf, const char* buf_end, GridWorld::registry& reg, uint32_t version)
+    {
+        size_t offset = 0;
+        size_t count = 0;
+        offset += copy_from_buffer(buf + offset, buf_end, count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            EntityId eid;
+            offset += copy_from_buffer(buf + offset, buf_end, eid);
+            reg.assign<C>(eid);
+        }
+
+        C* components = reg.raw<C>();
+        for (size_t i = 0; i < count; ++i)
+        {
+            offset += copy_from_buffer(buf + offset, buf_end, components[i], version);
+        }
+
+        return offset;
+    }
+
     template<class T>
     void push_tags_into_buffer(buffer& buf, const GridWorld::registry& reg)
     {
@@ -937,7 +1054,7 @@ namespace GridWorld::Binary
         size_t count = 0;
         offset += copy_from_buffer(buf + offset, buf_end, count);
 
-        for (int i = 0; i < count; ++i)
+        for (size_t i = 0; i < count; ++i)
         {
             EntityId eid;
             offset += copy_from_buffer(buf + offset, buf_end, eid);
@@ -970,7 +1087,7 @@ namespace GridWorld::Binary
         }
         else
         {
-            for (int i = 0; i < count; ++i)
+            for (size_t i = 0; i < count; ++i)
             {
                 push_into_buffer(buf, obj_array[i]);
             }
@@ -987,7 +1104,7 @@ namespace GridWorld::Binary
         else
         {
             size_t offset = 0;
-            for (int i = 0; i < count; ++i)
+            for (size_t i = 0; i < count; ++i)
             {
                 offset += copy_from_buffer(buf + offset, buf_end, obj_array[i]);
             }
@@ -1030,7 +1147,7 @@ namespace GridWorld::Binary
         size_t count = 0;
         offset += copy_from_buffer(buf + offset, buf_end, count);
         map.clear();
-        for (int i = 0; i < count; ++i)
+        for (size_t i = 0; i < count; ++i)
         {
             K key;
             offset += copy_from_buffer(buf + offset, buf_end, key);
@@ -1052,6 +1169,31 @@ GridWorld::registry create_empty_simulation_registry()
     using namespace GridWorld::Component;
     GridWorld::registry reg;
 
+    // EnTT caches the index of each component pool in a static shared by all registries,
+    // so every simulation registry (and every snapshot of one) must lay out its pools
+    // in the same order to be safely read from separate threads at the same time.
+    reg.prepare<Position>();
+    reg.prepare<Moveable>();
+    reg.prepare<Name>();
+    reg.prepare<RNG>();
+    reg.prepare<SimpleBrain>();
+    reg.prepare<SimpleBrainSeer>();
+    reg.prepare<SimpleBrainSectorSeer>();
+    reg.prepare<SimpleBrainMover>();
+    reg.prepare<Predation>();
+    reg.prepare<RandomMover>();
+    reg.prepare<Scorable>();
+    reg.prepare<SimpleBrainCache>(); // kept last, since snapshots leave it out
+
+    // Reflection looks up the name of every component an entity has
+    reg.visit([](ENTT_ID_TYPE com_id)
+    {
+        if (Reflect::com_id_name_map.count(com_id) == 0 && Reflect::transient_com_ids.count(com_id) == 0)
+        {
+            throw std::exception("Internal error. (Component has no name)");
+        }
+    });
+
     reg.ctx_or_set<SSimulationConfig>();
     reg.ctx_or_set<STickCounter>();
     reg.ctx_or_set<SWorld>();
@@ -1061,10 +1203,62 @@ GridWorld::registry create_empty_simulation_registry()
     return reg;
 }
 
+// Gives every SimpleBrain of a freshly loaded registry its SimpleBrainCache, since caches are never saved.
+void assign_brain_caches(GridWorld::registry& reg)
+{
+    using namespace GridWorld::Component;
+
+    for (GridWorld::EntityId eid : reg.view<SimpleBrain>())
+    {
+        reg.assign<SimpleBrainCache>(eid);
+    }
+}
+
+/*
+Creates an immutable copy of the simulation state, to be read while the simulation keeps running.
+SWorld's map is not copied, since it is derived from the Position components, and neither are brain caches.
+*/
+GridWorld::registry create_snapshot_registry(GridWorld::registry const& reg)
+{
+    using namespace GridWorld::Component;
+
+#pragma warning( suppress: 4996 )
+    GridWorld::registry snapshot = reg.clone(entt::exclude<SimpleBrainCache>);
+    snapshot.prepare<SimpleBrainCache>();
+
+    snapshot.set<SSimulationConfig>(reg.ctx<SSimulationConfig>());
+    snapshot.set<STickCounter>(reg.ctx<STickCounter>());
+    snapshot.set<SEventsLog>(reg.ctx<SEventsLog>());
+    snapshot.set<RNG>(reg.ctx<RNG>());
+
+    SWorld& world = snapshot.set<SWorld>();
+    world.width = reg.ctx<SWorld>().width;
+    world.height = reg.ctx<SWorld>().height;
+    world.use_tiled_layout = reg.ctx<SWorld>().use_tiled_layout;
+    world.use_sparse_layout = reg.ctx<SWorld>().use_sparse_layout;
+    world.map.clear();
+
+    return snapshot;
+}
+
 GridWorld::Simulation::Simulation()
 {
     reg = create_empty_simulation_registry();
     stop_requested = false;
+    pause_requests = 0;
+    loop_running = false;
+    tick_event_callback = nullptr;
+    tick_event_callback_interval = 1;
+    stop_at_tick = UINT64_MAX;
+    snapshot_reads = false;
+    snapshot_requested = false;
+    position_frames = false;
+    world_dirty = true;
+}
+
+GridWorld::Simulation::~Simulation()
+{
+    stop_simulation();
 }
 
 uint64_t GridWorld::Simulation::get_tick() const
@@ -1078,7 +1272,8 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_state_json() const
     using namespace rapidjson;
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
     StringBuffer buf;
     buf.Reserve(1024 * 100);
@@ -1089,9 +1284,9 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_state_json() const
     writer.Key("entities");
     {
         writer.StartArray();
-        for (int i = 0; i < reg.size(); i++)
+        for (int i = 0; i < state.size(); i++)
         {
-            writer.Uint64(to_integral(reg.data()[i]));
+            writer.Uint64(to_integral(state.data()[i]));
         }
         writer.EndArray();
     } // entities
@@ -1101,19 +1296,19 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_state_json() const
         writer.StartObject();
 
         writer.Key("SSimulationConfig");
-        json_write(reg.ctx<SSimulationConfig>(), writer);
+        json_write(state.ctx<SSimulationConfig>(), writer);
 
         writer.Key("STickCounter");
-        json_write(reg.ctx<STickCounter>(), writer);
+        json_write(state.ctx<STickCounter>(), writer);
 
         writer.Key("SWorld");
-        json_write(reg.ctx<SWorld>(), writer);
+        json_write(state.ctx<SWorld>(), writer);
 
         writer.Key("SEventsLog");
-        json_write(reg.ctx<SEventsLog>(), writer);
+        json_write(state.ctx<SEventsLog>(), writer);
 
         writer.Key("RNG");
-        json_write(reg.ctx<RNG>(), writer);
+        json_write(state.ctx<RNG>(), writer);
 
         writer.EndObject();
     } // singletons
@@ -1123,41 +1318,44 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_state_json() const
         writer.StartObject();
 
         writer.Key("Position");
-        json_write_components_array<Position>(reg, writer);
+        json_write_components_array<Position>(state, writer);
 
         writer.Key("Moveable");
-        json_write_components_array<Moveable>(reg, writer);
+        json_write_components_array<Moveable>(state, writer);
 
         writer.Key("Name");
-        json_write_components_array<Name>(reg, writer);
+        json_write_components_array<Name>(state, writer);
 
         writer.Key("RNG");
-        json_write_components_array<RNG>(reg, writer);
+        json_write_components_array<RNG>(state, writer);
 
         writer.Key("SimpleBrain");
-        json_write_components_array<SimpleBrain>(reg, writer);
+        json_write_components_array<SimpleBrain>(state, writer);
 
         writer.Key("SimpleBrainSeer");
-        json_write_components_array<SimpleBrainSeer>(reg, writer);
+        json_write_components_array<SimpleBrainSeer>(state, writer);
+
+        writer.Key("SimpleBrainSectorSeer");
+        json_write_components_array<SimpleBrainSectorSeer>(state, writer);
 
         writer.Key("SimpleBrainMover");
-        json_write_components_array<SimpleBrainMover>(reg, writer);
+        json_write_components_array<SimpleBrainMover>(state, writer);
 
         writer.Key("Predation");
-        json_write_components_array<Predation>(reg, writer);
+        json_write_components_array<Predation>(state, writer);
 
         writer.Key("Scorable");
-        json_write_components_array<Scorable>(reg, writer);
+        json_write_components_array<Scorable>(state, writer);
 
         writer.Key("RandomMover");
-        json_write_tags_array<RandomMover>(reg, writer);
+        json_write_tags_array<RandomMover>(state, writer);
 
         writer.EndObject();
     } // components
 
     writer.EndObject(); // root
 
-    return std::make_tuple(buf.GetString(), get_tick());
+    return std::make_tuple(buf.GetString(), rl.tick());
 }
 
 const char * state_schema = R"xx(
@@ -1287,6 +1485,11 @@ void GridWorld::Simulation::set_state_json(std::string json)
 
         json_read_components_array<SimpleBrainSeer>(tmp, components["SimpleBrainSeer"]);
 
+        if (components.HasMember("SimpleBrainSectorSeer"))
+        {
+            json_read_components_array<SimpleBrainSectorSeer>(tmp, components["SimpleBrainSectorSeer"]);
+        }
+
         json_read_components_array<SimpleBrainMover>(tmp, components["SimpleBrainMover"]);
 
         json_read_components_array<Predation>(tmp, components["Predation"]);
@@ -1296,6 +1499,8 @@ void GridWorld::Simulation::set_state_json(std::string json)
         json_read_tags_array<RandomMover>(tmp, components["RandomMover"]);
     }
 
+    assign_brain_caches(tmp);
+
     // Do the proper write mutex/running check here, 
     // after the parsed registry is ready to be copied in.
     unique_lock ul(simulation_mutex);
@@ -1309,6 +1514,7 @@ void GridWorld::Simulation::set_state_json(std::string json)
     }
 
     reg = std::move(tmp);
+    world_dirty = true;
 }
 
 uint64_t GridWorld::Simulation::create_entity()
@@ -1320,6 +1526,8 @@ uint64_t GridWorld::Simulation::create_entity()
         throw std::exception("create_entity cannot be used while simulation is running.");
     }
 
+    world_dirty = true;
+
     return to_integral(reg.create());
 }
 
@@ -1332,46 +1540,48 @@ void GridWorld::Simulation::destroy_entity(uint64_t eid)
         throw std::exception("destroy_entity cannot be used while simulation is running.");
     }
 
+    world_dirty = true;
+
     reg.destroy(EntityId{ eid });
 }
 
 std::tuple<std::vector<uint64_t>, uint64_t> GridWorld::Simulation::get_all_entities() const
 {
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
     std::vector<uint64_t> result;
-    result.reserve(reg.size());
-    const GridWorld::EntityId* data = reg.data();
-    for (int i = 0; i < reg.size(); i++)
+    result.reserve(state.size());
+    const GridWorld::EntityId* data = state.data();
+    for (int i = 0; i < state.size(); i++)
     {
-        if (reg.valid(data[i]))
+        if (state.valid(data[i]))
         {
-            result.push_back(to_integral(reg.data()[i]));
+            result.push_back(to_integral(state.data()[i]));
         }
     }
 
-    return std::make_tuple(result, get_tick());
+    return std::make_tuple(result, rl.tick());
 }
 
 void GridWorld::Simulation::start_simulation()
 {
     std::lock_guard control_guard(control_mutex);
+    std::lock_guard loop_guard(loop_mutex);
     if (!is_running())
     {
-        // Since the state may have been changed externally while the simulation
-        // wasn't running, ensure any hidden state is properly synced up
-        Systems::Util::rebuild_world(reg);
-
-        stop_requested = false;
-        simulation_thread = std::thread(&Simulation::simulation_loop, this);
+        stop_at_tick = UINT64_MAX;
+        start_simulation_thread();
     }
 }
 
 void GridWorld::Simulation::stop_simulation()
 {
     std::lock_guard control_guard(control_mutex);
-    if (is_running())
+
+    // The thread is joined even if its loop already finished by reaching stop_at_tick.
+    if (simulation_thread.joinable())
     {
         stop_requested = true;
         simulation_thread.join();
@@ -1380,7 +1590,7 @@ void GridWorld::Simulation::stop_simulation()
 
 bool GridWorld::Simulation::is_running() const
 {
-    return simulation_thread.joinable();
+    return loop_running;
 }
 
 void GridWorld::Simulation::assign_component(uint64_t eid_int, std::string component_name)
@@ -1397,6 +1607,8 @@ void GridWorld::Simulation::assign_component(uint64_t eid_int, std::string compo
         throw std::exception("assign_component cannot be used while simulation is running.");
     }
 
+    world_dirty = true;
+
     if (component_name == com_name<Position>())
     {
         reg.assign<Position>(eid);
@@ -1416,11 +1628,16 @@ void GridWorld::Simulation::assign_component(uint64_t eid_int, std::string compo
     else if (component_name == com_name<SimpleBrain>())
     {
         reg.assign<SimpleBrain>(eid);
+        reg.assign<SimpleBrainCache>(eid);
     }
     else if (component_name == com_name<SimpleBrainSeer>())
     {
         reg.assign<SimpleBrainSeer>(eid);
     }
+    else if (component_name == com_name<SimpleBrainSectorSeer>())
+    {
+        reg.assign<SimpleBrainSectorSeer>(eid);
+    }
     else if (component_name == com_name<SimpleBrainMover>())
     {
         reg.assign<SimpleBrainMover>(eid);
@@ -1455,39 +1672,44 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_component_json(uint
     Writer<StringBuffer> writer(buf);
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
     if (component_name == com_name<Position>())
     {
-        json_write(reg.get<Position>(eid), writer);
+        json_write(state.get<Position>(eid), writer);
     }
     else if (component_name == com_name<Moveable>())
     {
-        json_write(reg.get<Moveable>(eid), writer);
+        json_write(state.get<Moveable>(eid), writer);
     }
     else if (component_name == com_name<Name>())
     {
-        json_write(reg.get<Name>(eid), writer);
+        json_write(state.get<Name>(eid), writer);
     }
     else if (component_name == com_name<RNG>())
     {
-        json_write(reg.get<RNG>(eid), writer);
+        json_write(state.get<RNG>(eid), writer);
     }
     else if (component_name == com_name<SimpleBrain>())
     {
-        json_write(reg.get<SimpleBrain>(eid), writer);
+        json_write(state.get<SimpleBrain>(eid), writer);
     }
     else if (component_name == com_name<SimpleBrainSeer>())
     {
-        json_write(reg.get<SimpleBrainSeer>(eid), writer);
+        json_write(state.get<SimpleBrainSeer>(eid), writer);
+    }
+    else if (component_name == com_name<SimpleBrainSectorSeer>())
+    {
+        json_write(state.get<SimpleBrainSectorSeer>(eid), writer);
     }
     else if (component_name == com_name<SimpleBrainMover>())
     {
-        json_write(reg.get<SimpleBrainMover>(eid), writer);
+        json_write(state.get<SimpleBrainMover>(eid), writer);
     }
     else if (component_name == com_name<Predation>())
     {
-        json_write(reg.get<Predation>(eid), writer);
+        json_write(state.get<Predation>(eid), writer);
     }
     else if (component_name == com_name<RandomMover>())
     {
@@ -1495,14 +1717,14 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_component_json(uint
     }
     else if (component_name == com_name<Scorable>())
     {
-        json_write(reg.get<Scorable>(eid), writer);
+        json_write(state.get<Scorable>(eid), writer);
     }
     else
     {
         throw std::exception(("Unknown component type passed to get_component_json: " + component_name).c_str());
     }
 
-    return std::make_tuple(buf.GetString(), get_tick());
+    return std::make_tuple(buf.GetString(), rl.tick());
 }
 
 void GridWorld::Simulation::remove_component(uint64_t eid_int, std::string component_name)
@@ -1519,6 +1741,8 @@ void GridWorld::Simulation::remove_component(uint64_t eid_int, std::string compo
         throw std::exception("remove_component cannot be used while simulation is running.");
     }
 
+    world_dirty = true;
+
     if (component_name == com_name<Position>())
     {
         reg.remove<Position>(eid);
@@ -1538,11 +1762,16 @@ void GridWorld::Simulation::remove_component(uint64_t eid_int, std::string compo
     else if (component_name == com_name<SimpleBrain>())
     {
         reg.remove<SimpleBrain>(eid);
+        reg.remove_if_exists<SimpleBrainCache>(eid);
     }
     else if (component_name == com_name<SimpleBrainSeer>())
     {
         reg.remove<SimpleBrainSeer>(eid);
     }
+    else if (component_name == com_name<SimpleBrainSectorSeer>())
+    {
+        reg.remove<SimpleBrainSectorSeer>(eid);
+    }
     else if (component_name == com_name<SimpleBrainMover>())
     {
         reg.remove<SimpleBrainMover>(eid);
@@ -1579,6 +1808,8 @@ void GridWorld::Simulation::replace_component(uint64_t eid_int, std::string comp
         throw std::exception("replace_component cannot be used while simulation is running.");
     }
 
+    world_dirty = true;
+
     if (component_name == com_name<Position>())
     {
         JSON::json_read(reg.get<Position>(eid), component_json);
@@ -1598,11 +1829,16 @@ void GridWorld::Simulation::replace_component(uint64_t eid_int, std::string comp
     else if (component_name == com_name<SimpleBrain>())
     {
         JSON::json_read(reg.get<SimpleBrain>(eid), component_json);
+        reg.assign_or_replace<SimpleBrainCache>(eid);
     }
     else if (component_name == com_name<SimpleBrainSeer>())
     {
         JSON::json_read(reg.get<SimpleBrainSeer>(eid), component_json);
     }
+    else if (component_name == com_name<SimpleBrainSectorSeer>())
+    {
+        JSON::json_read(reg.get<SimpleBrainSectorSeer>(eid), component_json);
+    }
     else if (component_name == com_name<SimpleBrainMover>())
     {
         JSON::json_read(reg.get<SimpleBrainMover>(eid), component_json);
@@ -1631,6 +1867,7 @@ std::vector<std::string> GridWorld::Simulation::get_component_names() const
         com_name<RNG>(),
         com_name<SimpleBrain>(),
         com_name<SimpleBrainSeer>(),
+        com_name<SimpleBrainSectorSeer>(),
         com_name<SimpleBrainMover>(),
         com_name<Predation>(),
         com_name<RandomMover>(),
@@ -1644,13 +1881,19 @@ std::tuple<std::vector<std::string>, uint64_t> GridWorld::Simulation::get_entity
     std::vector<std::string> result;
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
-    reg.visit(EntityId(eid), [&result](ENTT_ID_TYPE com_id)
+    state.visit(EntityId(eid), [&result](ENTT_ID_TYPE com_id)
     {
-        result.push_back(id_to_com_name(com_id));
+        // Transient components have no name
+        auto iter = com_id_name_map.find(com_id);
+        if (iter != com_id_name_map.end())
+        {
+            result.push_back(iter->second);
+        }
     });
-    return std::make_tuple(result, get_tick());
+    return std::make_tuple(result, rl.tick());
 }
 
 std::tuple<std::string, uint64_t> GridWorld::Simulation::get_singleton_json(std::string singleton_name) const
@@ -1664,30 +1907,31 @@ std::tuple<std::string, uint64_t> GridWorld::Simulation::get_singleton_json(std:
     Writer<StringBuffer> writer(buf);
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
     if (singleton_name == com_name<SWorld>())
     {
-        json_write(reg.ctx<SWorld>(), writer);
+        json_write(state.ctx<SWorld>(), writer);
     }
     else if (singleton_name == com_name<SEventsLog>())
     {
-        json_write(reg.ctx<SEventsLog>(), writer);
+        json_write(state.ctx<SEventsLog>(), writer);
     }
     else if (singleton_name == com_name<SSimulationConfig>())
     {
-        json_write(reg.ctx<SSimulationConfig>(), writer);
+        json_write(state.ctx<SSimulationConfig>(), writer);
     }
     else if (singleton_name == com_name<RNG>())
     {
-        json_write(reg.ctx<RNG>(), writer);
+        json_write(state.ctx<RNG>(), writer);
     }
     else
     {
         throw std::exception(("Unknown component type passed to get_singleton_json: " + singleton_name).c_str());
     }
 
-    return std::make_tuple(buf.GetString(), get_tick());
+    return std::make_tuple(buf.GetString(), rl.tick());
 }
 
 void GridWorld::Simulation::set_singleton_json(std::string singleton_name, std::string singleton_json)
@@ -1702,6 +1946,8 @@ void GridWorld::Simulation::set_singleton_json(std::string singleton_name, std::
 
     unique_lock ul(simulation_mutex);
 
+    world_dirty = true;
+
     if (singleton_name == com_name<SWorld>())
     {
         JSON::json_read(reg.ctx<SWorld>(), singleton_json);
@@ -1750,29 +1996,34 @@ std::tuple<std::vector<char>, uint64_t> GridWorld::Simulation::get_state_binary(
     buf.reserve(1024 * 30);
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
-
-    push_array_into_buffer(buf, reg.data(), reg.size());
-
-    push_singleton_into_buffer<SSimulationConfig>(buf, reg);
-    push_singleton_into_buffer<STickCounter>(buf, reg);
-    push_singleton_into_buffer<SWorld>(buf, reg);
-    push_singleton_into_buffer<SEventsLog>(buf, reg);
-    push_singleton_into_buffer<RNG>(buf, reg);
-
-    push_components_into_buffer<Position>(buf, reg);
-    push_components_into_buffer<Moveable>(buf, reg);
-    push_components_into_buffer<Name>(buf, reg);
-    push_components_into_buffer<RNG>(buf, reg);
-    push_components_into_buffer<SimpleBrain>(buf, reg);
-    push_components_into_buffer<SimpleBrainSeer>(buf, reg);
-    push_components_into_buffer<SimpleBrainMover>(buf, reg);
-    push_components_into_buffer<Predation>(buf, reg);
-    push_components_into_buffer<Scorable>(buf, reg);
-
-    push_tags_into_buffer<RandomMover>(buf, reg);
-
-    return std::make_tuple(buf, get_tick());
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
+
+    push_into_buffer(buf, state_format_marker);
+    push_into_buffer(buf, state_format_version);
+
+    push_array_into_buffer(buf, state.data(), state.size());
+
+    push_singleton_into_buffer<SSimulationConfig>(buf, state);
+    push_singleton_into_buffer<STickCounter>(buf, state);
+    push_singleton_into_buffer<SWorld>(buf, state);
+    push_singleton_into_buffer<SEventsLog>(buf, state);
+    push_singleton_into_buffer<RNG>(buf, state);
+
+    push_components_into_buffer<Position>(buf, state);
+    push_components_into_buffer<Moveable>(buf, state);
+    push_components_into_buffer<Name>(buf, state);
+    push_components_into_buffer<RNG>(buf, state);
+    push_components_into_buffer<SimpleBrain>(buf, state);
+    push_components_into_buffer<SimpleBrainSeer>(buf, state);
+    push_components_into_buffer<SimpleBrainSectorSeer>(buf, state);
+    push_components_into_buffer<SimpleBrainMover>(buf, state);
+    push_components_into_buffer<Predation>(buf, state);
+    push_components_into_buffer<Scorable>(buf, state);
+
+    push_tags_into_buffer<RandomMover>(buf, state);
+
+    return std::make_tuple(buf, rl.tick());
 }
 
 void GridWorld::Simulation::set_state_binary(const char* bin, size_t size)
@@ -1793,6 +2044,23 @@ void GridWorld::Simulation::set_state_binary(const char* bin, size_t size)
 
     registry tmp = create_empty_simulation_registry();
 
+    uint32_t version = 0;
+    {
+        uint64_t marker;
+        copy_from_buffer(bin, bin_end, marker);
+
+        if (marker == state_format_marker)
+        {
+            offset += sizeof(marker);
+            offset += copy_from_buffer(bin + offset, bin_end, version);
+
+            if (version > state_format_version)
+            {
+                throw std::exception("Binary state was saved in a newer format.");
+            }
+        }
+    }
+
     {
         std::vector<EntityId> eids;
         offset += copy_from_buffer(bin + offset, bin_end, eids);
@@ -1801,9 +2069,9 @@ void GridWorld::Simulation::set_state_binary(const char* bin, size_t size)
     }
 
     {
-        offset += copy_singleton_from_buffer<SSimulationConfig>(bin + offset, bin_end, tmp);
+        offset += copy_from_buffer(bin + offset, bin_end, tmp.ctx<SSimulationConfig>(), version);
         offset += copy_singleton_from_buffer<STickCounter>(bin + offset, bin_end, tmp);
-        offset += copy_singleton_from_buffer<SWorld>(bin + offset, bin_end, tmp);
+        offset += copy_from_buffer(bin + offset, bin_end, tmp.ctx<SWorld>(), version);
         offset += copy_singleton_from_buffer<SEventsLog>(bin + offset, bin_end, tmp);
         offset += copy_singleton_from_buffer<RNG>(bin + offset, bin_end, tmp);
     }
@@ -1813,8 +2081,12 @@ void GridWorld::Simulation::set_state_binary(const char* bin, size_t size)
         offset += copy_components_from_buffer<Moveable>(bin + offset, bin_end, tmp);
         offset += copy_components_from_buffer<Name>(bin + offset, bin_end, tmp);
         offset += copy_components_from_buffer<RNG>(bin + offset, bin_end, tmp);
-        offset += copy_components_from_buffer<SimpleBrain>(bin + offset, bin_end, tmp);
+        offset += copy_components_from_buffer<SimpleBrain>(bin + offset, bin_end, tmp, version);
         offset += copy_components_from_buffer<SimpleBrainSeer>(bin + offset, bin_end, tmp);
+        if (version >= 1)
+        {
+            offset += copy_components_from_buffer<SimpleBrainSectorSeer>(bin + offset, bin_end, tmp);
+        }
         offset += copy_components_from_buffer<SimpleBrainMover>(bin + offset, bin_end, tmp);
         offset += copy_components_from_buffer<Predation>(bin + offset, bin_end, tmp);
         offset += copy_components_from_buffer<Scorable>(bin + offset, bin_end, tmp);
@@ -1822,7 +2094,10 @@ void GridWorld::Simulation::set_state_binary(const char* bin, size_t size)
         offset += copy_tags_from_buffer<RandomMover>(bin + offset, bin_end, tmp);
     }
 
+    assign_brain_caches(tmp);
+
     reg = std::move(tmp);
+    world_dirty = true;
 }
 
 uint64_t GridWorld::Simulation::get_events_last_tick(event_callback_function callback)
@@ -1834,21 +2109,23 @@ uint64_t GridWorld::Simulation::get_events_last_tick(event_callback_function cal
     Writer<StringBuffer> writer(buf);
 
     //shared_lock sl(simulation_mutex);
-    shared_pause_lock pl(pause_requests, no_pauses_requested, simulation_mutex);
+    state_read_lock rl(acquire_snapshot(), reg, pause_requests, no_pauses_requested, simulation_mutex);
+    const registry& state = rl.state();
 
-    for (const Events::Event& e : reg.ctx<Component::SEventsLog>().events_last_tick)
+    for (const Events::Event& e : state.ctx<Component::SEventsLog>().events_last_tick)
     {
         json_write(e.data, writer);
         callback(e.name.c_str(), buf.GetString());
         buf.Clear();
     }
 
-    return get_tick();
+    return rl.tick();
 }
 
 void GridWorld::Simulation::run_command(int64_t argc, const char* argv[], command_result_callback_function callback)
 {
     using namespace GridWorld::Component;
+    using namespace rapidjson;
 
     try
     {
@@ -1908,6 +2185,108 @@ void GridWorld::Simulation::run_command(int64_t argc, const char* argv[], comman
                 throw std::exception("Command 'randomize' can only accept up to 1 arguments.");
             }
         }
+        else if (command == "place_randomly")
+        {
+            unique_lock ul(simulation_mutex);
+
+            if (is_running())
+            {
+                throw std::exception("Command 'place_randomly' cannot be used while simulation is running.");
+            }
+
+            if (argc == 1)
+            {
+                throw std::exception("Command 'place_randomly' requires at least 1 argument.");
+            }
+
+            // moves each given entity onto a random empty tile, giving it a position if it has none
+            sync_world();
+            SWorld& world = reg.ctx<SWorld>();
+            RNG& srng = reg.ctx<RNG>();
+
+            for (int i = 1; i < argc; ++i)
+            {
+                auto eid_view = args[i];
+                uint64_t raw_eid = 0;
+                auto [p, ec] = std::from_chars(eid_view.data(), eid_view.data() + eid_view.size(), raw_eid);
+                EntityId eid = (EntityId)raw_eid;
+                if (ec != std::errc())
+                {
+                    throw std::exception("Provided EID does not have a valid format.");
+                }
+
+                if (!reg.valid(eid))
+                {
+                    throw std::exception("Provided EID does not exist.");
+                }
+
+                if (world.free_cell_count == 0)
+                {
+                    throw std::exception("No empty tiles are left to place entities on.");
+                }
+
+                if (Position* old_pos = reg.try_get<Position>(eid))
+                {
+                    if (world.get_map_data(old_pos->x, old_pos->y) == eid)
+                    {
+                        world.clear_map_data(old_pos->x, old_pos->y);
+                    }
+                }
+
+                int64_t new_pos_index = world.get_random_free_cell(srng);
+
+                Position& pos = reg.get_or_assign<Position>(eid);
+                pos.x = world.get_map_index_x(new_pos_index);
+                pos.y = world.get_map_index_y(new_pos_index);
+                world.set_map_data(pos.x, pos.y, eid, Systems::Util::get_tile_class(reg, eid));
+            }
+        }
+        else if (command == "benchmark_brains")
+        {
+            unique_lock ul(simulation_mutex);
+
+            if (is_running())
+            {
+                throw std::exception("Command 'benchmark_brains' cannot be used while simulation is running.");
+            }
+
+            int repeats = 100;
+            if (argc == 2)
+            {
+                auto [p, ec] = std::from_chars(args[1].data(), args[1].data() + args[1].size(), repeats);
+                if (ec != std::errc() || repeats <= 0)
+                {
+                    throw std::exception("Provided repeat count is not a positive integer.");
+                }
+            }
+            else if (argc > 2)
+            {
+                throw std::exception("Command 'benchmark_brains' can only accept up to 1 arguments.");
+            }
+
+            // evaluates copies of the current brains in float and in int8, leaving the simulation untouched
+            auto report = Systems::Util::compare_brain_precision(reg, repeats);
+
+            StringBuffer buf;
+            Writer<StringBuffer> writer(buf);
+
+            writer.StartObject();
+            writer.Key("brain_count");
+            writer.Uint64(report.brain_count);
+            writer.Key("repeats");
+            writer.Int(repeats);
+            writer.Key("float_seconds");
+            writer.Double(report.float_seconds);
+            writer.Key("quantized_seconds");
+            writer.Double(report.quantized_seconds);
+            writer.Key("max_output_error");
+            writer.Double(report.max_output_error);
+            writer.Key("changed_moves");
+            writer.Uint64(report.changed_moves);
+            writer.EndObject();
+
+            callback(nullptr, buf.GetString());
+        }
         else
         {
             throw std::exception("Unknown sim command provided.");
@@ -1925,17 +2304,21 @@ void GridWorld::Simulation::request_stop()
     stop_requested = true;
 }
 
-void update_tick(GridWorld::registry& reg)
+// The systems form a chain through the components they hand each other, so they run one after another;
+// the pool is only used from inside the systems that can split their own work.
+void update_tick(GridWorld::registry& reg, GridWorld::WorkerPool* pool)
 {
     using namespace GridWorld::Systems;
 
     tick_increment(reg);
-    simple_brain_seer(reg);
+    simple_brain_prepare(reg);
+    simple_brain_seer(reg, pool);
+    simple_brain_sector_seer(reg);
     simple_brain_calc(reg);
     simple_brain_mover(reg);
     random_movement(reg);
-    movement(reg);
-    predation(reg);
+    movement(reg, pool);
+    predation(reg, pool);
     evolution(reg);
     finalize_event_log(reg);
 }
@@ -1943,7 +2326,10 @@ void update_tick(GridWorld::registry& reg)
 void GridWorld::Simulation::simulation_loop()
 {
     unique_lock ul(simulation_mutex);
-    while (!stop_requested)
+    uint64_t ticks_since_callback = 0;
+    simulation_thread_id = std::this_thread::get_id();
+
+    while (continue_loop())
     {
         // For the update, aquire an exclusive lock to prevent reads during the sim update.
         // However, after the write is done, we do not need to (and should not) keep a
@@ -1961,18 +2347,238 @@ void GridWorld::Simulation::simulation_loop()
             no_pauses_requested.wait(simulation_mutex);
         }
 
-        update_tick(reg);
+        update_tick(reg, worker_pool.get());
+        ++ticks_since_callback;
 
-        if (tick_event_callback != nullptr)
+        // At most one snapshot is published per tick, and none while nobody reads them.
+        if (snapshot_requested.exchange(false))
         {
+            // Cloning only reads the registry, and writes wait for the loop to stop,
+            // so live readers do not need to be held off while it runs.
             ul.unlock();
+            publish_snapshot();
+            ul.lock();
+        }
+
+        if (position_frames)
+        {
+            publish_position_frame();
+        }
+
+        if (tick_event_callback != nullptr)
+        {
+            const auto& events_last_tick = reg.ctx<Component::SEventsLog>().events_last_tick;
+
+            // Events only live for a single tick, so a tick that produced events always
+            // gets a callback. Otherwise, the callback is only fired once per batch of
+            // ticks (an interval of 0 means only event ticks and the final tick fire it).
+            bool batch_finished =
+                (tick_event_callback_interval != 0 && ticks_since_callback >= tick_event_callback_interval)
+                || get_tick() >= stop_at_tick;
+
+            if (events_last_tick.size() > 0 || batch_finished)
+            {
+                ul.unlock();
+                uint64_t flags =
+                    // BIT 0: 1 if events have occured last tick, 0 otherwise
+                    1 * (events_last_tick.size() > 0);
+
+                tick_event_callback(get_tick(), flags);
+                ticks_since_callback = 0;
+                ul.lock();
+            }
+        }
+    }
+
+    simulation_thread_id = std::thread::id();
+
+    // Once stopped, the live state is current and free to read.
+    std::atomic_store(&published_snapshot, std::shared_ptr<const registry>());
+}
+
+uint64_t GridWorld::Simulation::step_ticks(uint64_t tick_count)
+{
+    uint64_t ticks_done = 0;
+
+    // The batch runs in segments that each end on a tick that produced events (or on
+    // the final tick), since events only live for a single tick and the callback has
+    // to see them before the next tick clears them.
+    while (ticks_done < tick_count)
+    {
+        uint64_t tick;
+        uint64_t flags;
+
+        {
+            // Hold the control mutex so the simulation thread cannot be started mid-segment.
+            std::lock_guard control_guard(control_mutex);
+            unique_lock ul(simulation_mutex);
+
+            if (is_running())
+            {
+                if (ticks_done == 0)
+                {
+                    throw std::exception("step_ticks cannot be used while simulation is running.");
+                }
+
+                // Started from the tick event callback, the running simulation takes over.
+                break;
+            }
+
+            // Same as start_simulation, the state may have been changed externally.
+            sync_world();
+
             const auto& events_last_tick = reg.ctx<Component::SEventsLog>().events_last_tick;
-            uint64_t flags =
+            do
+            {
+                update_tick(reg, worker_pool.get());
+                ++ticks_done;
+            } while (ticks_done < tick_count && (tick_event_callback == nullptr || events_last_tick.size() == 0));
+
+            if (position_frames)
+            {
+                publish_position_frame();
+            }
+
+            tick = get_tick();
+            flags =
                 // BIT 0: 1 if events have occured last tick, 0 otherwise
                 1 * (events_last_tick.size() > 0);
+        }
 
-            tick_event_callback(get_tick(), flags);
-            ul.lock();
+        if (tick_event_callback != nullptr)
+        {
+            tick_event_callback(tick, flags);
         }
     }
+
+    return get_tick();
+}
+
+void GridWorld::Simulation::run_until_tick(uint64_t tick)
+{
+    std::lock_guard control_guard(control_mutex);
+    std::lock_guard loop_guard(loop_mutex);
+
+    // If the simulation is already running, only the stopping point is moved.
+    stop_at_tick = tick;
+
+    if (!is_running())
+    {
+        start_simulation_thread();
+    }
+}
+
+bool GridWorld::Simulation::continue_loop()
+{
+    // Decided under the loop mutex, so run_until_tick either moves the stopping point
+    // of a loop that is going to see it, or finds the loop finished and starts a new one.
+    std::lock_guard loop_guard(loop_mutex);
+
+    if (stop_requested || get_tick() >= stop_at_tick)
+    {
+        loop_running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void GridWorld::Simulation::start_simulation_thread()
+{
+    // A loop that stopped by reaching stop_at_tick leaves a finished thread behind.
+    if (simulation_thread.joinable())
+    {
+        simulation_thread.join();
+    }
+
+    // Since the state may have been changed externally while the simulation
+    // wasn't running, ensure any hidden state is properly synced up
+    sync_world();
+
+    stop_requested = false;
+    std::atomic_store(&published_snapshot, std::shared_ptr<const registry>());
+    snapshot_requested = snapshot_reads.load();
+    loop_running = true;
+    simulation_thread = std::thread(&Simulation::simulation_loop, this);
+}
+
+void GridWorld::Simulation::sync_world()
+{
+    if (world_dirty)
+    {
+        Systems::Util::rebuild_world(reg);
+        world_dirty = false;
+    }
+}
+
+void GridWorld::Simulation::set_tick_event_callback_interval(uint64_t interval)
+{
+    unique_lock ul(simulation_mutex);
+    tick_event_callback_interval = interval;
+}
+
+void GridWorld::Simulation::set_snapshot_reads(bool enabled)
+{
+    snapshot_reads = enabled;
+
+    if (!enabled)
+    {
+        std::atomic_store(&published_snapshot, std::shared_ptr<const registry>());
+    }
+}
+
+std::shared_ptr<const GridWorld::registry> GridWorld::Simulation::acquire_snapshot() const
+{
+    // Reads made from the tick event callback happen on the simulation thread while it
+    // waits for the callback to return, so they must see the live state.
+    if (!snapshot_reads || !is_running() || std::this_thread::get_id() == simulation_thread_id)
+    {
+        return nullptr;
+    }
+
+    // Ask for a snapshot at the end of the current tick, but never wait for it: the latest
+    // published one holds the state from the first tick boundary after an earlier read.
+    // Until the first one is published, the live state is read under a pause lock instead.
+    snapshot_requested = true;
+    return std::atomic_load(&published_snapshot);
+}
+
+void GridWorld::Simulation::publish_snapshot()
+{
+    std::atomic_store(&published_snapshot, std::make_shared<const registry>(create_snapshot_registry(reg)));
+}
+
+void GridWorld::Simulation::set_position_frames(bool enabled)
+{
+    position_frames = enabled;
+}
+
+const GridWorld::PositionFrameView* GridWorld::Simulation::get_position_frame()
+{
+    return position_frame_buffer.acquire();
+}
+
+void GridWorld::Simulation::publish_position_frame()
+{
+    position_frame_buffer.back().write(reg);
+    position_frame_buffer.publish();
+}
+
+void GridWorld::Simulation::set_worker_threads(uint64_t thread_count)
+{
+    unique_lock ul(simulation_mutex);
+
+    if (is_running())
+    {
+        throw std::exception("set_worker_threads cannot be used while simulation is running.");
+    }
+
+    if (thread_count > 1)
+    {
+        worker_pool = std::make_unique<WorkerPool>(thread_count);
+    }
+    else
+    {
+        worker_pool = nullptr;
+    }
 }
@@ -11,6 +11,8 @@
 #include <condition_variable>
 
 #include "Registry.h"
+#include "PositionFrame.h"
+#include "WorkerPool.h"
 
 namespace GridWorld
 {
@@ -23,6 +25,8 @@ namespace GridWorld
 
         Simulation();
 
+        ~Simulation();
+
         uint64_t get_tick() const;
 
         std::tuple<std::string, uint64_t> get_state_json() const;
@@ -70,6 +74,20 @@ namespace GridWorld
         void run_command(int64_t argc, const char* argv[], command_result_callback_function callback);
 
         void request_stop();
+
+        uint64_t step_ticks(uint64_t tick_count);
+
+        void run_until_tick(uint64_t tick);
+
+        void set_tick_event_callback_interval(uint64_t interval);
+
+        void set_snapshot_reads(bool enabled);
+
+        void set_position_frames(bool enabled);
+
+        const PositionFrameView* get_position_frame();
+
+        void set_worker_threads(uint64_t thread_count);
     private:
         registry reg;
 
@@ -80,10 +98,40 @@ namespace GridWorld
         mutable std::condition_variable_any no_pauses_requested;
         mutable std::shared_mutex simulation_mutex;
         std::thread simulation_thread;
+        std::mutex loop_mutex;
+        std::atomic<bool> loop_running;
 
         tick_event_callback_function* tick_event_callback;
+        uint64_t tick_event_callback_interval;
+        std::atomic<uint64_t> stop_at_tick;
+
+        std::atomic<bool> snapshot_reads;
+        mutable std::atomic<bool> snapshot_requested;
+        std::shared_ptr<const registry> published_snapshot;
+        std::atomic<std::thread::id> simulation_thread_id;
+
+        std::atomic<bool> position_frames;
+        PositionFrameBuffer position_frame_buffer;
+
+        std::unique_ptr<WorkerPool> worker_pool;
+
+        // Set by everything that changes the state from outside the systems, which keep the world in sync themselves.
+        bool world_dirty;
 
 
         void simulation_loop();
+
+        bool continue_loop();
+
+        void start_simulation_thread();
+
+        // Rebuilds the world from the Position components if the state was changed since it was last in sync.
+        void sync_world();
+
+        std::shared_ptr<const registry> acquire_snapshot() const;
+
+        void publish_snapshot();
+
+        void publish_position_frame();
     };
 }
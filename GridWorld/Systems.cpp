@@ -1,13 +1,18 @@
 #include "stdafx.h"
 
 #include <vector>
-#include <set>
-#include <queue>
+#include <array>
+#include <unordered_map>
 #include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <emmintrin.h>
 #include <Eigen/Dense>
 
 #include "Systems.h"
 #include "components.h"
+#include "WorkerPool.h"
 
 using namespace GridWorld;
 using namespace GridWorld::Component;
@@ -28,38 +33,196 @@ struct map_lookup_result
     EntityId eid = entt::null;
 };
 
-void _get_entities_in_radius(SWorld& world, int x, int y, int radius, std::vector<map_lookup_result>& result)
+/*
+The tiles within a manhattan distance of radius from a center tile, in row-major order,
+with their linear map offsets for a world of the given width.
+*/
+struct _DiamondStencil
 {
-    result.clear();
+    int radius = -1;
+    int width = 0;
+    std::vector<int> x_offsets;
+    std::vector<int> y_offsets;
+    std::vector<int> map_offsets;
 
-    for (int cur_y_offset = -radius; cur_y_offset <= radius; cur_y_offset++)
+    _DiamondStencil() = default;
+
+    _DiamondStencil(int radius, int width) : radius(radius), width(width)
     {
-        int cur_x_radius = radius - abs(cur_y_offset);
-        for (int cur_x_offset = -cur_x_radius; cur_x_offset <= cur_x_radius; cur_x_offset++)
+        for (int cur_y_offset = -radius; cur_y_offset <= radius; cur_y_offset++)
         {
-            auto map_data = world.get_map_data(x + cur_x_offset, y + cur_y_offset);
-            if (map_data != entt::null)
+            int cur_x_radius = radius - abs(cur_y_offset);
+            for (int cur_x_offset = -cur_x_radius; cur_x_offset <= cur_x_radius; cur_x_offset++)
             {
-                result.push_back({ cur_x_offset, cur_y_offset, map_data });
+                x_offsets.push_back(cur_x_offset);
+                y_offsets.push_back(cur_y_offset);
+                map_offsets.push_back(cur_y_offset * width + cur_x_offset);
             }
         }
     }
-}
 
-void _get_map_data_in_radius(SWorld& world, int x, int y, int radius, std::vector<map_lookup_result>& result)
+    int size() const
+    {
+        return (int)map_offsets.size();
+    }
+
+    // True if the whole diamond around (x, y) lies inside the map, so no offset needs wrapping.
+    bool fits_without_wrapping(SWorld const& world, int x, int y) const
+    {
+        return x - radius >= 0 && x + radius < world.width && y - radius >= 0 && y + radius < world.height;
+    }
+};
+
+/*
+Stencils for every radius in use, kept in the registry context between ticks and rebuilt only when the world width
+changes. A negative radius sees nothing. Systems register each radius they need with prepare before splitting
+their work across threads, which then only look stencils up with get.
+*/
+struct _DiamondStencilCache
 {
-    result.clear();
+    std::vector<_DiamondStencil> stencils;
+    int max_size = 0;
+
+    _DiamondStencil const& prepare(SWorld const& world, int radius)
+    {
+        size_t index = std::max(radius, -1) + 1;
+        if (index >= stencils.size())
+        {
+            stencils.resize(index + 1);
+        }
+
+        _DiamondStencil& stencil = stencils[index];
+        if (stencil.width != world.width)
+        {
+            stencil = _DiamondStencil(std::max(radius, -1), world.width);
+            max_size = std::max(max_size, stencil.size());
+        }
+        return stencil;
+    }
 
-    for (int cur_y_offset = -radius; cur_y_offset <= radius; cur_y_offset++)
+    _DiamondStencil const& get(int radius) const
     {
-        int cur_x_radius = radius - abs(cur_y_offset);
-        for (int cur_x_offset = -cur_x_radius; cur_x_offset <= cur_x_radius; cur_x_offset++)
+        return stencils[std::max(radius, -1) + 1];
+    }
+};
+
+/*
+Calls f(i, map_index) for the i-th tile of the stencil around (x, y).
+Diamonds that lie inside a row-major map only add the precomputed offsets to the center index;
+diamonds inside a tiled or sparse map skip the wrapping; only diamonds crossing the torus seam wrap each tile.
+*/
+template<class F>
+void _for_each_stencil_tile(SWorld const& world, _DiamondStencil const& stencil, int x, int y, F&& f)
+{
+    if (!stencil.fits_without_wrapping(world, x, y))
+    {
+        for (int i = 0; i < stencil.size(); i++)
         {
-            auto map_data = world.get_map_data(x + cur_x_offset, y + cur_y_offset);
-            result.push_back({ cur_x_offset, cur_y_offset, map_data });
+            f(i, world.get_map_index(x + stencil.x_offsets[i], y + stencil.y_offsets[i]));
+        }
+    }
+    else if (world.tiled || world.sparse)
+    {
+        for (int i = 0; i < stencil.size(); i++)
+        {
+            f(i, world.to_map_index(x + stencil.x_offsets[i], y + stencil.y_offsets[i]));
+        }
+    }
+    else
+    {
+        int64_t center_index = int64_t(y) * world.width + x;
+        for (int i = 0; i < stencil.size(); i++)
+        {
+            f(i, center_index + stencil.map_offsets[i]);
         }
     }
 }
+
+/*
+Finds entities on tiles with any of the given class flags.
+result must have room for stencil.size() entries. Returns the number of entities found.
+*/
+int _get_entities_in_radius(SWorld& world, _DiamondStencil const& stencil, int x, int y, uint8_t tile_class, map_lookup_result* result)
+{
+    int found = 0;
+
+    _for_each_stencil_tile(world, stencil, x, y, [&world, &stencil, tile_class, result, &found](int i, int64_t map_index)
+    {
+        if (world.tile_classes[map_index] & tile_class)
+        {
+            result[found++] = { stencil.x_offsets[i], stencil.y_offsets[i], world.map[map_index] };
+        }
+    });
+
+    return found;
+}
+
+/*
+Writes the class of every tile in the stencil around (x, y) into result, which must have room for stencil.size() entries.
+*/
+void _get_tile_classes_in_radius(SWorld& world, _DiamondStencil const& stencil, int x, int y, uint8_t* result)
+{
+    const uint8_t* tile_classes = world.tile_classes.data();
+
+    _for_each_stencil_tile(world, stencil, x, y, [tile_classes, result](int i, int64_t map_index)
+    {
+        result[i] = tile_classes[map_index];
+    });
+}
+
+// Below this many entities, splitting a neighbourhood-scanning system across threads costs more than it saves.
+constexpr size_t min_parallel_entities = 1024;
+
+/*
+Horizontal strips of the world, each processed as one task, for systems that split their work spatially.
+Entities are sorted into the strip holding their row, so each task reads its own part of the map plus
+the rows its entities can see beyond the strip's edges, which are only read during these systems.
+There is an even number of strips, each at least 2 rows tall, so entities in strips of the same parity can never
+reach the same tile with a radius-1 neighbourhood, even across the torus seam.
+*/
+struct _WorldStrips
+{
+    int count = 0;
+    std::vector<std::vector<EntityId>> entities;
+
+    // Returns false, leaving no strips, if the work should be done serially instead.
+    bool split(SWorld const& world, WorkerPool* pool, size_t entity_count)
+    {
+        count = 0;
+        if (pool == nullptr || pool->thread_count() <= 1 || entity_count < min_parallel_entities)
+        {
+            return false;
+        }
+
+        count = (int)std::min<int64_t>(pool->thread_count() * 4, world.height / 2) & ~1;
+        if (count < 2)
+        {
+            count = 0;
+            return false;
+        }
+
+        entities.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            entities[i].clear();
+        }
+        return true;
+    }
+
+    void add(SWorld const& world, EntityId eid, Position const& position)
+    {
+        entities[int(int64_t(world.normalize_y(position.y)) * count / world.height)].push_back(eid);
+    }
+};
+
+thread_local _WorldStrips predation_strips;
+
+// Scratch space for the seer, kept in the registry context so it lives as long as the simulation.
+struct _SeerScratch
+{
+    _WorldStrips strips;
+    std::vector<std::vector<uint8_t>> tile_classes; // One buffer per strip, or a single one when seeing serially
+};
 #pragma endregion Helper Functions
 
 void GridWorld::Systems::tick_increment(registry & reg)
@@ -68,26 +231,102 @@ void GridWorld::Systems::tick_increment(registry & reg)
 }
 
 #pragma region Movement
-struct _MovementInfo
+struct _MovementNode
 {
-    int map_index = -1;
-    std::vector<_MovementInfo*> child_nodes;
-    _MovementInfo* parent_node = NULL;
+    int64_t map_index = -1;
+    int parent_node = -1;
+    int first_child = -1;
+    int next_sibling = -1;
     bool is_entry_node = false;
     EntityId eid = entt::null;
     Position* entity_position = NULL;
     int net_force = 0;
     bool finalized = false;
-    _MovementInfo* accepted_child = NULL;
+    int accepted_child = -1;
+    int visit_mark = -1;
+    uint8_t tile_class = TILE_EMPTY;
 };
 
-using movement_node_map = std::unordered_map<int, _MovementInfo>;
-using movement_node_set = std::set<_MovementInfo*>;
+/*
+Scratch space for resolving movement, reused every tick.
+Nodes refer to each other by index into the node array. Each tile of the world maps to the node created for it,
+and a tile's entry is only valid if it was stamped with the current epoch, so nothing has to be cleared between ticks.
+*/
+struct _MovementGraph
+{
+    std::vector<_MovementNode> nodes;
+    std::vector<int> tile_nodes;
+    std::vector<uint32_t> tile_epochs;
+    uint32_t epoch = 0;
+    std::vector<int> entry_nodes;
+    std::vector<int64_t> vacated_tiles;
+
+    void reset(size_t tile_count)
+    {
+        nodes.clear();
+        entry_nodes.clear();
+
+        if (tile_epochs.size() != tile_count || epoch == UINT32_MAX)
+        {
+            tile_nodes.assign(tile_count, -1);
+            tile_epochs.assign(tile_count, 0);
+            epoch = 0;
+        }
+
+        epoch++;
+    }
+
+    // Makes room for tiles added to the map since the last reset.
+    void grow(size_t tile_count)
+    {
+        if (tile_epochs.size() < tile_count)
+        {
+            tile_nodes.resize(tile_count, -1);
+            tile_epochs.resize(tile_count, 0);
+        }
+    }
 
-thread_local movement_node_map movement_nodes; // Declared globally to keep in memory
-thread_local movement_node_set movement_entry_nodes;
+    int find_node(int64_t map_index) const
+    {
+        return tile_epochs[map_index] == epoch ? tile_nodes[map_index] : -1;
+    }
 
-void _add_movement_info(EntityId eid, SWorld& world, Moveable& moveable, Position& position)
+    int create_node(int64_t map_index, EntityId eid, uint8_t tile_class)
+    {
+        int node_index = (int)nodes.size();
+        _MovementNode& node = nodes.emplace_back();
+        node.map_index = map_index;
+        node.eid = eid;
+        node.tile_class = tile_class;
+
+        tile_nodes[map_index] = node_index;
+        tile_epochs[map_index] = epoch;
+        return node_index;
+    }
+
+    void add_child(int node_index, int child_index)
+    {
+        nodes[child_index].next_sibling = nodes[node_index].first_child;
+        nodes[node_index].first_child = child_index;
+    }
+
+    void remove_child(int node_index, int child_index)
+    {
+        int* link = &nodes[node_index].first_child;
+        while (*link != child_index)
+        {
+            link = &nodes[*link].next_sibling;
+        }
+        *link = nodes[child_index].next_sibling;
+        nodes[child_index].next_sibling = -1;
+    }
+};
+
+thread_local _MovementGraph movement_graph; // Declared globally to keep in memory
+thread_local std::vector<int> movement_traversal_queue; // Per thread, since trees may be resolved concurrently
+
+template<bool PowerOfTwo>
+void _add_movement_info(_MovementGraph& graph, EntityId eid, SWorld& world, Moveable& moveable, Position& position)
 {
     int abs_x_force = abs(moveable.x_force);
     int abs_y_force = abs(moveable.y_force);
@@ -126,82 +365,122 @@ void _add_movement_info(EntityId eid, SWorld& world, Moveable& moveable, Positio
         net_force = -true_y_force;
     }
 
-    int cur_map_index = world.get_map_index(position.x, position.y);
-    int new_map_index = world.get_map_index(new_x, new_y);
-
-    _MovementInfo* cur_movement_info = NULL;
-    auto cur_iter = movement_nodes.find(cur_map_index);
-    if (cur_iter != movement_nodes.end())
+    int64_t cur_map_index = world.get_writable_map_index<PowerOfTwo>(position.x, position.y);
+    int64_t new_map_index = world.get_writable_map_index<PowerOfTwo>(new_x, new_y);
+    if (world.sparse)
     {
-        cur_movement_info = &cur_iter->second;
-    }
-    else
-    {
-        cur_movement_info = &movement_nodes[cur_map_index];
-        cur_movement_info->map_index = cur_map_index;
-        cur_movement_info->eid = eid;
+        graph.grow(world.map.size());
     }
 
-    _MovementInfo* new_movement_info = NULL;
-    auto new_iter = movement_nodes.find(new_map_index);
-    if (new_iter != movement_nodes.end())
+    int cur_node_index = graph.find_node(cur_map_index);
+    if (cur_node_index == -1)
     {
-        new_movement_info = &new_iter->second;
+        cur_node_index = graph.create_node(cur_map_index, eid, world.tile_classes[cur_map_index]);
     }
-    else
+
+    int new_node_index = graph.find_node(new_map_index);
+    if (new_node_index == -1)
     {
-        new_movement_info = &movement_nodes[new_map_index];
-        new_movement_info->map_index = new_map_index;
-        new_movement_info->eid = world.map[new_map_index];
-        new_movement_info->is_entry_node = true;
-        movement_entry_nodes.insert(new_movement_info);
+        new_node_index = graph.create_node(new_map_index, world.map[new_map_index], world.tile_classes[new_map_index]);
     }
 
-    cur_movement_info->net_force = net_force;
-    cur_movement_info->entity_position = &position;
+    _MovementNode& cur_node = graph.nodes[cur_node_index];
+    cur_node.net_force = net_force;
+    cur_node.entity_position = &position;
 
-    if (cur_movement_info->parent_node != new_movement_info)
+    if (cur_node.parent_node != new_node_index)
     {
         // erase self from old parent if we had one
-        if (cur_movement_info->parent_node != NULL)
+        if (cur_node.parent_node != -1)
         {
-            auto& parent_children = cur_movement_info->parent_node->child_nodes;
-            parent_children.erase(remove(parent_children.begin(), parent_children.end(), cur_movement_info));
+            graph.remove_child(cur_node.parent_node, cur_node_index);
         }
 
-        cur_movement_info->parent_node = new_movement_info;
-        new_movement_info->child_nodes.push_back(cur_movement_info);
+        cur_node.parent_node = new_node_index;
+        graph.add_child(new_node_index, cur_node_index);
     }
+}
 
-    _MovementInfo* search_node = cur_movement_info->parent_node;
+/*
+Marks one entry node for every tree of the movement graph.
+Since every node has at most one parent, each tree either ends in a root with no parent, or in exactly one cycle.
+Roots are entry nodes. Cycles are found by following parents from every unvisited node, marking the nodes
+with where the walk started; running into a node marked by the same walk means the walk closed a cycle,
+and that node becomes the cycle's entry node. Every node is walked over once.
+*/
+void _find_entry_nodes(_MovementGraph& graph)
+{
+    int node_count = (int)graph.nodes.size();
 
-    // Verify that our graph has just one entry node by searching for an entry node among our parents.
-    while (!search_node->is_entry_node && search_node != cur_movement_info)
+    for (int i = 0; i < node_count; i++)
     {
-        search_node = search_node->parent_node;
+        int search_node = i;
+        while (search_node != -1 && graph.nodes[search_node].visit_mark == -1)
+        {
+            _MovementNode& node = graph.nodes[search_node];
+            node.visit_mark = i;
+            if (node.parent_node == -1)
+            {
+                node.is_entry_node = true;
+                graph.entry_nodes.push_back(search_node);
+            }
+            search_node = node.parent_node;
+        }
+
+        if (search_node != -1 && graph.nodes[search_node].visit_mark == i)
+        {
+            graph.nodes[search_node].is_entry_node = true;
+            graph.entry_nodes.push_back(search_node);
+        }
     }
+}
+
+// Accepts the child with the highest force (or no child if a tie exists), and queues every child for traversal.
+void _accept_most_forceful_child(_MovementGraph& graph, std::vector<int>& traversal_queue, _MovementNode& node)
+{
+    int highest_force = -1;
+    int highest_child = -1;
 
-    if (search_node != cur_movement_info && cur_movement_info->is_entry_node)
+    for (int child = node.first_child; child != -1; child = graph.nodes[child].next_sibling)
     {
-        // Found an entry node that is not ourselves, and we used to be an entry node,
-        // so we remove ourselves as an entry node
-        cur_movement_info->is_entry_node = false;
-        movement_entry_nodes.erase(cur_movement_info);
+        int child_force = graph.nodes[child].net_force;
+        if (child_force > highest_force)
+        {
+            highest_child = child;
+            highest_force = child_force;
+        }
+        else if (child_force == highest_force)
+        {
+            highest_child = -1;
+        }
+
+        traversal_queue.push_back(child);
     }
-    else if (search_node == cur_movement_info && !cur_movement_info->is_entry_node)
+
+    node.accepted_child = highest_child;
+    node.finalized = true;
+}
+
+// Rejects every child, and queues them for traversal.
+void _reject_all_children(_MovementGraph& graph, std::vector<int>& traversal_queue, _MovementNode& node)
+{
+    for (int child = node.first_child; child != -1; child = graph.nodes[child].next_sibling)
     {
-        // We did not find an entry node among our parents and arrived back to ourselves.
-        // That means there is no entry node in our loop, so make ourselves an entry node.
-        cur_movement_info->is_entry_node = true;
-        movement_entry_nodes.insert(cur_movement_info);
+        traversal_queue.push_back(child);
     }
+
+    node.accepted_child = -1;
+    node.finalized = true;
 }
 
-void _traverse_and_resolve_movement(_MovementInfo& entry_node)
+void _traverse_and_resolve_movement(_MovementGraph& graph, std::vector<int>& traversal_queue, int entry_node_index)
 {
+    _MovementNode& entry_node = graph.nodes[entry_node_index];
+
     assert(entry_node.is_entry_node);
 
-    std::queue<_MovementInfo*> traversal_queue;
+    // The queue is consumed front to back rather than popped, so its memory is kept between ticks.
+    traversal_queue.clear();
 
     /*
     Special handling for the entry node.
@@ -210,267 +489,1006 @@ void _traverse_and_resolve_movement(_MovementInfo& entry_node)
     Otherwise, the node is empty and should accept the child with highest force (or no child if a tie exists).
     */
 
-    if (entry_node.parent_node != NULL)
+    if (entry_node.parent_node != -1)
     {
         // cycle case, the entry node has a parent it wants to move to.
-        auto* previous_cycle_node = &entry_node;
-        auto* current_cycle_node = entry_node.parent_node;
+        int previous_cycle_node = entry_node_index;
+        int current_cycle_node = entry_node.parent_node;
 
-        while (!current_cycle_node->finalized)
+        while (!graph.nodes[current_cycle_node].finalized)
         {
-            current_cycle_node->accepted_child = previous_cycle_node;
-            current_cycle_node->finalized = true;
+            _MovementNode& cycle_node = graph.nodes[current_cycle_node];
+            cycle_node.accepted_child = previous_cycle_node;
+            cycle_node.finalized = true;
 
-            for (auto* child : current_cycle_node->child_nodes)
+            for (int child = cycle_node.first_child; child != -1; child = graph.nodes[child].next_sibling)
             {
                 if (child != previous_cycle_node)
                 {
-                    traversal_queue.push(child);
+                    traversal_queue.push_back(child);
                 }
             }
 
             previous_cycle_node = current_cycle_node;
-            current_cycle_node = current_cycle_node->parent_node;
+            current_cycle_node = cycle_node.parent_node;
+        }
+    }
+    else if (entry_node.eid != entt::null)
+    {
+        // reject children case (entity exists and is not moving)
+        _reject_all_children(graph, traversal_queue, entry_node);
+    }
+    else
+    {
+        _accept_most_forceful_child(graph, traversal_queue, entry_node);
+    }
+
+    /*
+    Normal handling for non-cycle, non-entry nodes.
+    If the parent node accepted me, accept the child with the highest force (If tied, accept none).
+    If the parent node rejected me, reject all children.
+    */
+
+    for (size_t i = 0; i < traversal_queue.size(); i++)
+    {
+        int cur_node_index = traversal_queue[i];
+        _MovementNode& cur_node = graph.nodes[cur_node_index];
+
+        assert(!cur_node.finalized);
+
+        if (graph.nodes[cur_node.parent_node].accepted_child == cur_node_index)
+        {
+            _accept_most_forceful_child(graph, traversal_queue, cur_node);
+        }
+        else
+        {
+            _reject_all_children(graph, traversal_queue, cur_node);
+        }
+    }
+}
+
+// Returns the map index of the tile that was emptied by the movement, if any.
+template<bool PowerOfTwo>
+int64_t _traverse_and_execute_movement(_MovementGraph& graph, SWorld& world, int entry_node_index)
+{
+    assert(graph.nodes[entry_node_index].is_entry_node);
+
+    _MovementNode* cur_node = &graph.nodes[entry_node_index];
+    int64_t cur_map_index = cur_node->map_index;
+
+    while (cur_node->accepted_child != -1 && world.map[cur_map_index] != graph.nodes[cur_node->accepted_child].eid)
+    {
+        _MovementNode& accepted_child = graph.nodes[cur_node->accepted_child];
+
+        world.map[cur_map_index] = accepted_child.eid;
+        world.tile_classes[cur_map_index] = accepted_child.tile_class;
+        accepted_child.entity_position->x = world.get_map_index_x<PowerOfTwo>(cur_map_index);
+        accepted_child.entity_position->y = world.get_map_index_y<PowerOfTwo>(cur_map_index);
+
+        cur_node = &accepted_child;
+        cur_map_index = cur_node->map_index;
+    }
+
+    // special case: if any nodes were moved, we need to make sure the last node of the tree clears out its position if necessary 
+    // (since it wasn't iterated over)
+    if (cur_node->accepted_child == -1 && cur_node != &graph.nodes[entry_node_index])
+    {
+        world.map[cur_map_index] = entt::null;
+        world.tile_classes[cur_map_index] = TILE_EMPTY;
+        return cur_map_index;
+    }
+
+    return -1;
+}
+
+// Below this many trees, handing them to other threads costs more than it saves.
+constexpr size_t min_parallel_entry_nodes = 1024;
+
+template<bool PowerOfTwo>
+void _movement(registry & reg, WorkerPool* pool)
+{
+    auto& world = reg.ctx<SWorld>();
+    auto& graph = movement_graph;
+
+    graph.reset(world.map.size());
+
+    auto view = reg.view<Moveable, Position>();
+
+    view.each([&graph, &world](EntityId eid, Moveable& moveable, Position& position)
+    {
+        _add_movement_info<PowerOfTwo>(graph, eid, world, moveable, position);
+
+        moveable.x_force = 0;
+        moveable.y_force = 0;
+    });
+
+    _find_entry_nodes(graph);
+
+    auto& entry_nodes = graph.entry_nodes;
+    auto& vacated_tiles = graph.vacated_tiles;
+    vacated_tiles.resize(entry_nodes.size());
+
+    if (pool == nullptr || pool->thread_count() <= 1 || entry_nodes.size() < min_parallel_entry_nodes)
+    {
+        for (int entry_node : entry_nodes)
+        {
+            _traverse_and_resolve_movement(graph, movement_traversal_queue, entry_node);
+        }
+
+        for (size_t i = 0; i < entry_nodes.size(); i++)
+        {
+            vacated_tiles[i] = _traverse_and_execute_movement<PowerOfTwo>(graph, world, entry_nodes[i]);
+        }
+    }
+    else
+    {
+        // Every tree only touches its own nodes, and the map tiles and positions of those nodes.
+        // Trees can therefore be resolved and executed concurrently, without changing the result.
+        size_t task_count = std::min(pool->thread_count() * 4, entry_nodes.size() / min_parallel_entry_nodes);
+
+        pool->run(task_count, [&graph, &world, &entry_nodes, &vacated_tiles, task_count](size_t task)
+        {
+            size_t begin = entry_nodes.size() * task / task_count;
+            size_t end = entry_nodes.size() * (task + 1) / task_count;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                _traverse_and_resolve_movement(graph, movement_traversal_queue, entry_nodes[i]);
+                vacated_tiles[i] = _traverse_and_execute_movement<PowerOfTwo>(graph, world, entry_nodes[i]);
+            }
+        });
+    }
+
+    // Within a tree, only the entry tile can become occupied and only the last tile can become empty.
+    for (size_t i = 0; i < entry_nodes.size(); i++)
+    {
+        world.sync_free_cell(graph.nodes[entry_nodes[i]].map_index);
+        if (vacated_tiles[i] != -1)
+        {
+            world.sync_free_cell(vacated_tiles[i]);
+        }
+    }
+
+    world.release_empty_chunks();
+}
+
+void GridWorld::Systems::movement(registry & reg, WorkerPool* pool)
+{
+    if (reg.ctx<SWorld>().power_of_two)
+    {
+        _movement<true>(reg, pool);
+    }
+    else
+    {
+        _movement<false>(reg, pool);
+    }
+}
+#pragma endregion Movement
+
+#pragma region Simple Brain Calc
+/*
+All brains sharing a topology, so each topology picks its kernel once per tick.
+Every brain has its own synapses, so the brains of a batch cannot share one matrix product per layer;
+each is evaluated in place on its own cache's neurons.
+*/
+struct _BrainBatch
+{
+    std::vector<Eigen::Index> layer_sizes;
+    std::vector<SimpleBrain*> brains;
+    std::vector<SimpleBrainCache*> caches;
+};
+
+thread_local std::vector<_BrainBatch> brain_batches; // Declared globally to keep in memory
+
+void _relu(float* data, Eigen::Index size)
+{
+    for (Eigen::Index i = 0; i < size; i++)
+    {
+        float& element = *(data + i);
+        if (element < 0)
+        {
+            element = 0;
+        }
+    }
+}
+
+// mask must not be 0.
+int _lowest_set_bit(uint64_t mask)
+{
+    return (int)std::bitset<64>((mask & (0 - mask)) - 1).count();
+}
+
+/*
+Seer inputs are all 0 or 1, and mostly 0, so a first layer fed only by them is just the sum of the synapse rows of
+the active inputs. Sets output to the sum of the synapse rows whose bits are set in mask.
+*/
+template<class Synapses, class Output>
+void _add_active_synapse_rows(uint64_t mask, Synapses const& synapses, Output&& output)
+{
+    output.setZero();
+    for (; mask != 0; mask &= mask - 1)
+    {
+        output += synapses.row(_lowest_set_bit(mask));
+    }
+}
+
+_BrainBatch& _get_brain_batch(SimpleBrainCache const& cache)
+{
+    auto matches_topology = [&cache](_BrainBatch& batch)
+    {
+        if (batch.layer_sizes.size() != cache.neurons.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < cache.neurons.size(); i++)
+        {
+            if (batch.layer_sizes[i] != cache.neurons[i].size())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    auto iter = std::find_if(brain_batches.begin(), brain_batches.end(), matches_topology);
+    if (iter != brain_batches.end())
+    {
+        return *iter;
+    }
+
+    _BrainBatch& batch = brain_batches.emplace_back();
+    for (NeuronMat const& layer : cache.neurons)
+    {
+        batch.layer_sizes.push_back(layer.size());
+    }
+    return batch;
+}
+
+void _calc_brain_batch(_BrainBatch& batch)
+{
+    for (size_t b = 0; b < batch.brains.size(); b++)
+    {
+        SimpleBrain const& brain = *batch.brains[b];
+        SimpleBrainCache const& cache = *batch.caches[b];
+        std::vector<NeuronMat>& neurons = batch.caches[b]->neurons;
+        size_t layer_count = neurons.size();
+
+        for (size_t i = 0; i < layer_count - 1; i++)
+        {
+            bool has_bias = !(i == layer_count - 2);
+            NeuronMat const& input = neurons[i];
+            NeuronMat& output = neurons[i + 1];
+
+            // the bias neuron keeps its value
+            auto weighted_output = output.rightCols(output.cols() - has_bias);
+
+            if (i == 0 && cache.binary_inputs)
+            {
+                _add_active_synapse_rows(cache.input_bits, brain.synapses[i], weighted_output);
+            }
+            else
+            {
+                weighted_output.noalias() = input * brain.synapses[i];
+            }
+
+            // every layer is relu'd, including the final output
+            _relu(output.data(), output.size());
+        }
+    }
+}
+
+/*
+Evaluates a batch of brains with a topology known at compile time.
+The layers are mapped as fixed-size matrices directly over each brain's own synapses and neurons,
+so the products are fully unrolled and nothing is gathered or scattered.
+*/
+template<int In, int Hidden, int Out>
+void _calc_fixed_brain_batch(_BrainBatch& batch)
+{
+    using InputMat = Eigen::Matrix<float, 1, In>;
+    using HiddenMat = Eigen::Matrix<float, 1, Hidden>;
+    using OutputMat = Eigen::Matrix<float, 1, Out>;
+    using InputSynapseMat = Eigen::Matrix<float, In, Hidden - 1>;
+    using HiddenSynapseMat = Eigen::Matrix<float, Hidden, Out>;
+
+    for (size_t b = 0; b < batch.brains.size(); b++)
+    {
+        SimpleBrain const* brain = batch.brains[b];
+        SimpleBrainCache const& cache = *batch.caches[b];
+        std::vector<NeuronMat>& neurons = batch.caches[b]->neurons;
+        Eigen::Map<InputMat> input(neurons[0].data());
+        Eigen::Map<HiddenMat> hidden(neurons[1].data());
+        Eigen::Map<OutputMat> output(neurons[2].data());
+
+        // the bias neuron keeps its value
+        auto weighted_hidden = hidden.template tail<Hidden - 1>();
+        Eigen::Map<const InputSynapseMat> input_synapses(brain->synapses[0].data());
+
+        if (cache.binary_inputs)
+        {
+            _add_active_synapse_rows(cache.input_bits, input_synapses, weighted_hidden);
+        }
+        else
+        {
+            weighted_hidden.noalias() = input * input_synapses;
+        }
+        _relu(hidden.data(), Hidden);
+
+        output.noalias() = hidden * Eigen::Map<const HiddenSynapseMat>(brain->synapses[1].data());
+        _relu(output.data(), Out);
+    }
+}
+
+/*
+Builds the brain's int8 synapses in its cache, scaling each matrix by a power of two so that its largest weight lands in [64, 127].
+The float synapses are left as they are: they remain what is saved and inherited, so mutations smaller than a quantization step
+still accumulate across generations.
+*/
+void _quantize_brain(SimpleBrain const& brain, SimpleBrainCache& cache)
+{
+    cache.quantized_synapses.resize(brain.synapses.size());
+    cache.synapse_scales.resize(brain.synapses.size());
+
+    for (size_t i = 0; i < brain.synapses.size(); i++)
+    {
+        SynapseMat const& synapses = brain.synapses[i];
+        QuantizedSynapseMat& quantized = cache.quantized_synapses[i];
+        quantized.resize(synapses.rows(), synapses.cols());
+
+        int exponent;
+        std::frexp(synapses.size() > 0 ? synapses.cwiseAbs().maxCoeff() : 0.f, &exponent);
+        float scale = std::ldexp(1.f, exponent - 7); // every |weight| / scale is below 128
+
+        for (Eigen::Index col = 0; col < synapses.cols(); col++)
+        {
+            for (Eigen::Index row = 0; row < synapses.rows(); row++)
+            {
+                float steps = std::clamp(std::round(synapses(row, col) / scale), -127.f, 127.f);
+                quantized(row, col) = (int8_t)steps;
+            }
+        }
+
+        cache.synapse_scales[i] = scale;
+    }
+
+    cache.quantized = true;
+}
+
+// Adds values times the four int32 weights in ints to the four floats at output.
+void _add_widened_weights(__m128 values, __m128i ints, float* output)
+{
+    _mm_storeu_ps(output, _mm_add_ps(_mm_loadu_ps(output), _mm_mul_ps(values, _mm_cvtepi32_ps(ints))));
+}
+
+// Sign-extends the low (or high) four 16 bit lanes of words to 32 bits.
+__m128i _widen_low_words(__m128i words)
+{
+    return _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+}
+
+__m128i _widen_high_words(__m128i words)
+{
+    return _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+}
+
+/*
+Adds value times the first count int8 weights of row to output, widening 16 weights at a time with SSE2, which every
+x64 processor has. Every output gets the same multiply and add as in the scalar tail, so results are the same however
+a row's length splits between the two.
+*/
+void _add_quantized_row(float value, int8_t const* row, float* output, Eigen::Index count)
+{
+    __m128 values = _mm_set1_ps(value);
+    Eigen::Index j = 0;
+
+    for (; j + 16 <= count; j += 16)
+    {
+        // unpacking a byte into both halves of a 16 bit lane and shifting back down sign-extends it
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + j));
+        __m128i low_words = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        __m128i high_words = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+
+        _add_widened_weights(values, _widen_low_words(low_words), output + j);
+        _add_widened_weights(values, _widen_high_words(low_words), output + j + 4);
+        _add_widened_weights(values, _widen_low_words(high_words), output + j + 8);
+        _add_widened_weights(values, _widen_high_words(high_words), output + j + 12);
+    }
+
+    for (; j + 4 <= count; j += 4)
+    {
+        int32_t packed;
+        std::memcpy(&packed, row + j, sizeof(packed));
+        __m128i bytes = _mm_cvtsi32_si128(packed);
+        __m128i words = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+
+        _add_widened_weights(values, _widen_low_words(words), output + j);
+    }
+
+    for (; j < count; j++)
+    {
+        output[j] += value * row[j];
+    }
+}
+
+/*
+Evaluates a brain from the int8 synapses in its cache, which must be built.
+Synapse rows are accumulated only for non-zero inputs, so the mostly empty seer inputs are skipped, and each row is
+widened and accumulated with SIMD; each matrix's scale is applied once per output.
+*/
+void _calc_quantized_brain(SimpleBrainCache& cache)
+{
+    size_t layer_count = cache.neurons.size();
+
+    for (size_t i = 0; i < layer_count - 1; i++)
+    {
+        bool has_bias = !(i == layer_count - 2);
+        NeuronMat const& input = cache.neurons[i];
+        NeuronMat& output = cache.neurons[i + 1];
+        QuantizedSynapseMat const& synapses = cache.quantized_synapses[i];
+
+        // the bias neuron keeps its value
+        float* weighted_output = output.data() + has_bias;
+        Eigen::Index weighted_count = synapses.cols();
+        std::fill(weighted_output, weighted_output + weighted_count, 0.f);
+
+        if (i == 0 && cache.binary_inputs)
+        {
+            for (uint64_t bits = cache.input_bits; bits != 0; bits &= bits - 1)
+            {
+                _add_quantized_row(1.f, synapses.data() + _lowest_set_bit(bits) * weighted_count, weighted_output, weighted_count);
+            }
+        }
+        else
+        {
+            for (Eigen::Index k = 0; k < input.size(); k++)
+            {
+                if (input(k) != 0)
+                {
+                    _add_quantized_row(input(k), synapses.data() + k * weighted_count, weighted_output, weighted_count);
+                }
+            }
+        }
+
+        Eigen::Map<Eigen::ArrayXf>(weighted_output, weighted_count) *= cache.synapse_scales[i];
+
+        _relu(output.data(), output.size());
+    }
+}
+
+bool _has_neurons_for(SimpleBrain const& brain, SimpleBrainCache const& cache)
+{
+    if (cache.neurons.size() != brain.get_layer_count())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < cache.neurons.size(); i++)
+    {
+        if (cache.neurons[i].size() != brain.get_layer_size(i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Sizes the cache's neurons to the brain's layers, all ones, so every bias neuron is 1.
+void _reset_neurons(SimpleBrain const& brain, SimpleBrainCache& cache)
+{
+    cache.neurons.resize(brain.get_layer_count());
+    for (size_t i = 0; i < cache.neurons.size(); i++)
+    {
+        cache.neurons[i].setOnes(brain.get_layer_size(i));
+    }
+    cache.binary_inputs = false;
+    cache.evaluated = false;
+}
+
+// Writes binary inputs back into the input neurons, ahead of writing some of them as floats.
+void _expand_input_bits(SimpleBrainCache& cache)
+{
+    if (!cache.binary_inputs)
+    {
+        return;
+    }
+
+    NeuronMat& inputs = cache.neurons[0];
+    for (Eigen::Index k = 0; k < inputs.size(); k++)
+    {
+        inputs(k) = float((cache.input_bits >> k) & 1);
+    }
+    cache.binary_inputs = false;
+}
+
+// Compares bitwise, so that even -0 and NaN inputs are only skipped when evaluating would give the same bits.
+bool _inputs_unchanged(SimpleBrainCache const& cache)
+{
+    if (!cache.evaluated || cache.evaluated_binary != cache.binary_inputs)
+    {
+        return false;
+    }
+
+    if (cache.binary_inputs)
+    {
+        return cache.evaluated_input_bits == cache.input_bits;
+    }
+
+    NeuronMat const& inputs = cache.neurons[0];
+    return cache.evaluated_inputs.size() == inputs.size()
+        && std::memcmp(cache.evaluated_inputs.data(), inputs.data(), inputs.size() * sizeof(float)) == 0;
+}
+
+bool _has_topology(_BrainBatch const& batch, std::initializer_list<Eigen::Index> layer_sizes)
+{
+    return std::equal(batch.layer_sizes.begin(), batch.layer_sizes.end(), layer_sizes.begin(), layer_sizes.end());
+}
+
+// Evaluates every brain gathered into brain_batches. Quantized brains must have their int8 synapses built in their caches.
+void _calc_brain_batches(bool quantized)
+{
+    for (_BrainBatch& batch : brain_batches)
+    {
+        if (batch.brains.empty())
+        {
+            continue;
+        }
+
+        if (quantized)
+        {
+            for (size_t b = 0; b < batch.brains.size(); b++)
+            {
+                _calc_quantized_brain(*batch.caches[b]);
+            }
+        }
+        // the default topology gets its own kernel, anything else falls back to the dynamic one
+        else if (_has_topology(batch, { 27, 9, 4 }))
+        {
+            _calc_fixed_brain_batch<27, 9, 4>(batch);
+        }
+        else
+        {
+            _calc_brain_batch(batch);
+        }
+    }
+}
+
+void GridWorld::Systems::simple_brain_prepare(registry & reg)
+{
+    reg.view<SimpleBrain, SimpleBrainCache>().each([](SimpleBrain& brain, SimpleBrainCache& cache)
+    {
+        if (!_has_neurons_for(brain, cache))
+        {
+            _reset_neurons(brain, cache);
+        }
+    });
+}
+
+void GridWorld::Systems::simple_brain_calc(registry & reg)
+{
+    bool quantized = reg.ctx<SSimulationConfig>().quantized_brains;
+
+    for (_BrainBatch& batch : brain_batches)
+    {
+        batch.brains.clear();
+        batch.caches.clear();
+    }
+
+    reg.view<SimpleBrain, SimpleBrainCache>().each([quantized](SimpleBrain& brain, SimpleBrainCache& cache)
+    {
+        NeuronMat& inputs = cache.neurons[0];
+        if (!cache.binary_inputs)
+        {
+            _relu(inputs.data(), inputs.size());
+        }
+
+        // switching precision changes what the neurons evaluate to
+        if (cache.quantized != quantized)
+        {
+            if (quantized)
+            {
+                _quantize_brain(brain, cache);
+            }
+            cache.quantized = quantized;
+            cache.evaluated = false;
+        }
+
+        // the other layers are a pure function of the inputs, so they still hold what evaluating would give
+        if (_inputs_unchanged(cache))
+        {
+            return;
+        }
+
+        if (cache.binary_inputs)
+        {
+            cache.evaluated_input_bits = cache.input_bits;
+        }
+        else
+        {
+            cache.evaluated_inputs = inputs;
+        }
+        cache.evaluated_binary = cache.binary_inputs;
+        cache.evaluated = true;
+
+        _BrainBatch& batch = _get_brain_batch(cache);
+        batch.brains.push_back(&brain);
+        batch.caches.push_back(&cache);
+    });
+
+    _calc_brain_batches(quantized);
+}
+
+GridWorld::Systems::Util::BrainPrecisionReport GridWorld::Systems::Util::compare_brain_precision(registry& reg, int repeats)
+{
+    std::vector<SimpleBrain*> brains;
+    std::vector<SimpleBrainCache> float_caches;
+    auto brain_view = reg.view<SimpleBrain>();
+    for (EntityId eid : brain_view)
+    {
+        SimpleBrain& brain = brain_view.get(eid);
+        brains.push_back(&brain);
+
+        // brains that have not been prepared yet are compared from all ones inputs
+        SimpleBrainCache& cache = float_caches.emplace_back();
+        SimpleBrainCache const* brain_cache = reg.try_get<SimpleBrainCache>(eid);
+        if (brain_cache != nullptr && _has_neurons_for(brain, *brain_cache))
+        {
+            cache.neurons = brain_cache->neurons;
+            cache.input_bits = brain_cache->input_bits;
+            cache.binary_inputs = brain_cache->binary_inputs;
+        }
+        else
+        {
+            _reset_neurons(brain, cache);
         }
+        _relu(cache.neurons[0].data(), cache.neurons[0].size());
     }
-    else if (entry_node.eid != entt::null)
+
+    std::vector<SimpleBrainCache> quantized_caches = float_caches;
+    for (size_t b = 0; b < brains.size(); b++)
     {
-        // reject children case (entity exists and is not moving)
-        entry_node.accepted_child = NULL;
-        entry_node.finalized = true;
+        _quantize_brain(*brains[b], quantized_caches[b]);
+    }
 
-        for (auto* child : entry_node.child_nodes)
+    auto time_brains = [repeats, &brains](std::vector<SimpleBrainCache>& caches, bool quantized)
+    {
+        for (_BrainBatch& batch : brain_batches)
         {
-            traversal_queue.push(child);
+            batch.brains.clear();
+            batch.caches.clear();
+        }
+        for (size_t b = 0; b < brains.size(); b++)
+        {
+            _BrainBatch& batch = _get_brain_batch(caches[b]);
+            batch.brains.push_back(brains[b]);
+            batch.caches.push_back(&caches[b]);
         }
-    }
-    else
-    {
-        // Accept most forceful child case.
-        int highest_force = -1;
-        _MovementInfo* highest_child = NULL;
 
-        for (auto* child : entry_node.child_nodes)
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
         {
-            if (child->net_force > highest_force)
-            {
-                highest_child = child;
-                highest_force = child->net_force;
-            }
-            else if (child->net_force == highest_force)
-            {
-                highest_child = NULL;
-            }
+            _calc_brain_batches(quantized);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-            traversal_queue.push(child);
+        for (_BrainBatch& batch : brain_batches)
+        {
+            batch.brains.clear();
+            batch.caches.clear();
         }
+        return elapsed.count();
+    };
+
+    BrainPrecisionReport report;
+    report.brain_count = brains.size();
+    report.float_seconds = time_brains(float_caches, false);
+    report.quantized_seconds = time_brains(quantized_caches, true);
+
+    for (size_t b = 0; b < brains.size(); b++)
+    {
+        NeuronMat const& float_output = float_caches[b].neurons.back();
+        NeuronMat const& quantized_output = quantized_caches[b].neurons.back();
 
-        entry_node.accepted_child = highest_child;
-        entry_node.finalized = true;
+        bool move_changed = false;
+        for (Eigen::Index i = 0; i < float_output.size(); i++)
+        {
+            report.max_output_error = std::max(report.max_output_error, std::abs(float_output(i) - quantized_output(i)));
+            move_changed |= int(float_output(i)) != int(quantized_output(i));
+        }
+        report.changed_moves += move_changed;
     }
 
-    /*
-    Normal handling for non-cycle, non-entry nodes.
-    If the parent node accepted me, accept the child with the highest force (If tied, accept none).
-    If the parent node rejected me, reject all children.
-    */
+    return report;
+}
+#pragma endregion
 
-    while (!traversal_queue.empty())
+/*
+Sets bits to the inputs outside of [first, end) that equal 1, or returns false if any of them is neither 0 nor 1
+or the brain has more than 64 inputs.
+*/
+bool _get_unseen_input_bits(SimpleBrainCache const& cache, int first, int end, uint64_t& bits)
+{
+    NeuronMat const& inputs = cache.neurons[0];
+    if (inputs.size() > 64 || first < 0 || end > inputs.size())
     {
-        auto* cur_node = traversal_queue.front();
-        traversal_queue.pop();
+        return false;
+    }
 
-        assert(!cur_node->finalized);
+    if (cache.binary_inputs)
+    {
+        uint64_t seen = (end - first < 64 ? (uint64_t(1) << (end - first)) - 1 : UINT64_MAX) << first;
+        bits = cache.input_bits & ~seen;
+        return true;
+    }
 
-        if (cur_node->parent_node->accepted_child == cur_node)
+    bits = 0;
+    for (int k = 0; k < inputs.size(); k++)
+    {
+        if (k >= first && k < end)
         {
-            // Accept most forceful child case.
-            int highest_force = -1;
-            _MovementInfo* highest_child = NULL;
-
-            for (auto* child : cur_node->child_nodes)
-            {
-                if (child->net_force > highest_force)
-                {
-                    highest_child = child;
-                    highest_force = child->net_force;
-                }
-                else if (child->net_force == highest_force)
-                {
-                    highest_child = NULL;
-                }
-
-                traversal_queue.push(child);
-            }
+            continue;
+        }
 
-            cur_node->accepted_child = highest_child;
-            cur_node->finalized = true;
+        if (inputs(k) == 1.f)
+        {
+            bits |= uint64_t(1) << k;
         }
-        else
+        else if (inputs(k) != 0.f)
         {
-            cur_node->accepted_child = NULL;
-            cur_node->finalized = true;
-
-            for (auto* child : cur_node->child_nodes)
-            {
-                traversal_queue.push(child);
-            }
+            return false;
         }
     }
+    return true;
 }
 
-void _traverse_and_execute_movement(SWorld& world, _MovementInfo& entry_node)
+/*
+Seen tiles are all 0 or 1, so when the rest of the inputs are too (typically just the bias neuron), the seer writes
+them all as bits into the cache's input_bits, for the brain kernels to use directly, and leaves the input neurons be.
+tile_classes must have room for the stencil.
+*/
+void _see(SWorld& world, _DiamondStencil const& stencil, uint8_t* tile_classes, SimpleBrainCache& cache, SimpleBrainSeer& seer, Position& position)
 {
-    assert(entry_node.is_entry_node);
+    int first_neuron = seer.neuron_offset;
+    int end_neuron = first_neuron + 2 * stencil.size();
 
-    auto* cur_node = &entry_node;
-    int cur_map_index = cur_node->map_index;
+    _get_tile_classes_in_radius(world, stencil, position.x, position.y, tile_classes);
 
-    while (cur_node->accepted_child != NULL && world.map[cur_map_index] != cur_node->accepted_child->eid)
+    uint64_t bits;
+    if (_get_unseen_input_bits(cache, first_neuron, end_neuron, bits))
     {
-        world.map[cur_map_index] = cur_node->accepted_child->eid;
-        cur_node->accepted_child->entity_position->x = world.get_map_index_x(cur_map_index);
-        cur_node->accepted_child->entity_position->y = world.get_map_index_y(cur_map_index);
+        for (int i = 0; i < stencil.size(); i++)
+        {
+            uint8_t tile_class = tile_classes[i];
 
-        cur_node = cur_node->accepted_child;
-        cur_map_index = cur_node->map_index;
+            // a predator bit and a non-predator bit per tile, both 0 if nothing is seen
+            bool predator_seen = tile_class & TILE_PREDATOR;
+            bool non_predator_seen = (tile_class & TILE_OCCUPIED) && !predator_seen;
+
+            bits |= uint64_t(predator_seen) << (first_neuron + 2 * i);
+            bits |= uint64_t(non_predator_seen) << (first_neuron + 2 * i + 1);
+        }
+
+        cache.input_bits = bits;
+        cache.binary_inputs = true;
+        return;
     }
 
-    // special case: if any nodes were moved, we need to make sure the last node of the tree clears out its position if necessary 
-    // (since it wasn't iterated over)
-    if (cur_node->accepted_child == NULL && cur_node != &entry_node)
+    NeuronMat& input_neurons = cache.neurons[0];
+    int cur_neuron_offset = first_neuron;
+
+    for (int i = 0; i < stencil.size(); i++)
     {
-        world.map[cur_map_index] = entt::null;
+        uint8_t tile_class = tile_classes[i];
+
+        // a predator neuron and a non-predator neuron per tile, both 0 if nothing is seen
+        bool predator_seen = tile_class & TILE_PREDATOR;
+        bool non_predator_seen = (tile_class & TILE_OCCUPIED) && !predator_seen;
+
+        input_neurons(cur_neuron_offset) = predator_seen;
+        input_neurons(cur_neuron_offset + 1) = non_predator_seen;
+        cur_neuron_offset += 2; // iterate in sets of 2 (predator neuron + nonpredator neuron)
     }
 }
 
-void GridWorld::Systems::movement(registry & reg)
+void GridWorld::Systems::simple_brain_seer(registry & reg, WorkerPool* pool)
 {
-    auto& world = reg.ctx<SWorld>();
+    SWorld& world = reg.ctx<SWorld>();
 
-    auto view = reg.view<Moveable, Position>();
+    auto simple_brain_view = reg.view<SimpleBrainCache, SimpleBrainSeer, Position>();
+    auto& stencils = reg.ctx_or_set<_DiamondStencilCache>();
+    auto& scratch = reg.ctx_or_set<_SeerScratch>();
+    auto& strips = scratch.strips;
 
-    view.each([&world](EntityId eid, Moveable& moveable, Position& position)
+    if (!strips.split(world, pool, simple_brain_view.size()))
     {
-        _add_movement_info(eid, world, moveable, position);
+        scratch.tile_classes.resize(1);
+        std::vector<uint8_t>& tile_classes = scratch.tile_classes[0];
 
-        moveable.x_force = 0;
-        moveable.y_force = 0;
-    });
+        simple_brain_view.each([&world, &stencils, &tile_classes](SimpleBrainCache& cache, SimpleBrainSeer& seer, Position& position)
+        {
+            _DiamondStencil const& stencil = stencils.prepare(world, seer.sight_radius);
+            tile_classes.resize(stencils.max_size);
+            _see(world, stencil, tile_classes.data(), cache, seer, position);
+        });
+        return;
+    }
 
-    for (auto entry_node : movement_entry_nodes)
+    simple_brain_view.each([&world, &stencils, &strips](EntityId eid, SimpleBrainCache&, SimpleBrainSeer& seer, Position& position)
     {
-        _traverse_and_resolve_movement(*entry_node);
-    }
+        stencils.prepare(world, seer.sight_radius);
+        strips.add(world, eid, position);
+    });
 
-    for (auto entry_node : movement_entry_nodes)
+    scratch.tile_classes.resize(strips.count);
+    for (std::vector<uint8_t>& tile_classes : scratch.tile_classes)
     {
-        _traverse_and_execute_movement(world, *entry_node);
+        tile_classes.resize(stencils.max_size);
     }
 
-    movement_nodes.clear();
-    movement_entry_nodes.clear();
-}
-#pragma endregion Movement
-
-#pragma region Simple Brain Calc
-void _relu(NeuronMat& mat)
-{
-    auto data = mat.data();
-    for (Eigen::Index i = 0, size = mat.size(); i < size; i++)
+    // Every seer only writes its own brain, so the strips are independent.
+    pool->run(strips.count, [&world, &stencils, &scratch, &simple_brain_view](size_t strip)
     {
-        float& element = *(data + i);
-        if (element < 0)
+        uint8_t* tile_classes = scratch.tile_classes[strip].data();
+
+        for (EntityId eid : scratch.strips.entities[strip])
         {
-            element = 0;
+            auto [cache, seer, position] = simple_brain_view.get<SimpleBrainCache, SimpleBrainSeer, Position>(eid);
+            _see(world, stencils.get(seer.sight_radius), tile_classes, cache, seer, position);
         }
-    }
+    });
 }
 
-void GridWorld::Systems::simple_brain_calc(registry & reg)
+/*
+Summed-area tables of the predators and of the other entities on the map,
+so the number of either in any rectangle of tiles can be read in constant time.
+Rebuilt from tile_classes every tick sector seers exist, which costs one pass over the whole map.
+*/
+struct _SummedAreaTables
 {
-    auto brain_view = reg.view<SimpleBrain>();
-    for (EntityId eid : brain_view)
+    int width = 0;
+    int height = 0;
+
+    // Entry (x, y), at y * (width + 1) + x, counts the tiles above row y and left of column x.
+    std::vector<int> predators;
+    std::vector<int> others;
+
+    void build(SWorld const& world)
     {
-        auto& brain = brain_view.get(eid);
+        width = world.width;
+        height = world.height;
 
-        for (auto i = 0; i < brain.synapses.size(); i++)
-        {
-            bool has_bias = !(i == brain.synapses.size() - 1);
-            SynapseMat& synapse_mat = brain.synapses[i];
-            NeuronMat& input = brain.neurons[i];
-            NeuronMat& output = brain.neurons[i + 1];
+        size_t stride = (size_t)width + 1;
+        predators.assign(stride * (height + 1), 0);
+        others.assign(stride * (height + 1), 0);
 
-            // relu first
-            _relu(input);
+        for (int y = 0; y < height; y++)
+        {
+            int row_predators = 0;
+            int row_others = 0;
+            size_t above = y * stride;
+            size_t row = above + stride;
 
-            if (has_bias)
+            for (int x = 0; x < width; x++)
             {
-                output.rightCols(output.cols() - 1) = input * synapse_mat;
-            }
-            else
-            {
-                output = input * synapse_mat;
+                uint8_t tile_class = world.tile_classes[world.to_map_index(x, y)];
+                bool predator = tile_class & TILE_PREDATOR;
+                row_predators += predator;
+                row_others += (tile_class & TILE_OCCUPIED) && !predator;
+
+                predators[row + x + 1] = predators[above + x + 1] + row_predators;
+                others[row + x + 1] = others[above + x + 1] + row_others;
             }
         }
+    }
+
+    // Adds the counts of the rectangle [x0, x1) x [y0, y1), which must lie within the map.
+    void add_counts(int x0, int y0, int x1, int y1, int& predator_count, int& other_count) const
+    {
+        size_t stride = (size_t)width + 1;
+        size_t top = y0 * stride;
+        size_t bottom = y1 * stride;
 
-        // finally, for now we also apply relu to the final output
-        _relu(brain.neurons.back());
+        predator_count += predators[bottom + x1] - predators[top + x1] - predators[bottom + x0] + predators[top + x0];
+        other_count += others[bottom + x1] - others[top + x1] - others[bottom + x0] + others[top + x0];
     }
-}
-#pragma endregion
 
-void GridWorld::Systems::simple_brain_seer(registry & reg)
-{
-    SWorld& world = reg.ctx<SWorld>();
+    /*
+    Counts the predators and other entities in the w by h tiles from (x, y), wrapping around the torus.
+    x and y must be within the map, and w and h no larger than it.
+    */
+    void count(int x, int y, int w, int h, int& predator_count, int& other_count) const
+    {
+        predator_count = 0;
+        other_count = 0;
+
+        int x_end = std::min(x + w, width);
+        int y_end = std::min(y + h, height);
+        int x_wrapped = x + w - x_end;
+        int y_wrapped = y + h - y_end;
+
+        add_counts(x, y, x_end, y_end, predator_count, other_count);
+        if (x_wrapped > 0)
+        {
+            add_counts(0, y, x_wrapped, y_end, predator_count, other_count);
+        }
+        if (y_wrapped > 0)
+        {
+            add_counts(x, 0, x_end, y_wrapped, predator_count, other_count);
+        }
+        if (x_wrapped > 0 && y_wrapped > 0)
+        {
+            add_counts(0, 0, x_wrapped, y_wrapped, predator_count, other_count);
+        }
+    }
+};
 
-    auto simple_brain_view = reg.view<SimpleBrain, SimpleBrainSeer, Position>();
-    auto predator_view = reg.view<Predation>();
-    std::vector<map_lookup_result> map_data;
-    map_data.reserve(20);
+thread_local _SummedAreaTables sector_seer_tables; // Declared globally to keep in memory
 
-    simple_brain_view.each([&world, &predator_view, &map_data](SimpleBrain& brain, SimpleBrainSeer& seer, Position& position)
+void GridWorld::Systems::simple_brain_sector_seer(registry & reg)
+{
+    auto sector_seer_view = reg.view<SimpleBrainCache, SimpleBrainSectorSeer, Position>();
+    if (sector_seer_view.begin() == sector_seer_view.end())
     {
-        NeuronMat& input_neurons = brain.neurons[0];
+        return;
+    }
 
-        int cur_neuron_offset = seer.neuron_offset;
+    SWorld& world = reg.ctx<SWorld>();
+    auto& tables = sector_seer_tables;
+    tables.build(world);
 
-        _get_map_data_in_radius(world, position.x, position.y, seer.sight_radius, map_data);
+    sector_seer_view.each([&world, &tables](SimpleBrainCache& cache, SimpleBrainSectorSeer& seer, Position& position)
+    {
+        // densities are fractions, so the inputs are floats from here on
+        _expand_input_bits(cache);
+        NeuronMat& input_neurons = cache.neurons[0];
+
+        int x = world.normalize_x(position.x);
+        int y = world.normalize_y(position.y);
+
+        // Sectors stop short of wrapping back onto the seer's own row or column, so no tile is seen twice.
+        int reach_x = std::clamp(seer.sight_radius, 0, world.width - 1);
+        int reach_y = std::clamp(seer.sight_radius, 0, world.height - 1);
+        int span_x = std::min(2 * reach_x + 1, world.width);
+        int span_y = std::min(2 * reach_y + 1, world.height);
+        int left = world.normalize_x(x - (span_x - 1) / 2);
+        int top = world.normalize_y(y - (span_y - 1) / 2);
+
+        // x, y, width and height of the north, east, south and west sectors
+        const int sectors[4][4] = {
+            { left, world.normalize_y(y - reach_y), span_x, reach_y },
+            { world.normalize_x(x + 1), top, reach_x, span_y },
+            { left, world.normalize_y(y + 1), span_x, reach_y },
+            { world.normalize_x(x - reach_x), top, reach_x, span_y },
+        };
 
-        for (auto result : map_data)
+        int cur_neuron_offset = seer.neuron_offset;
+        for (auto& sector : sectors)
         {
-            if (result.eid == entt::null)
+            int predator_count = 0;
+            int other_count = 0;
+            int area = sector[2] * sector[3];
+            if (area > 0)
             {
-                // nothing seen
-                input_neurons(cur_neuron_offset) = 0;
-                input_neurons(cur_neuron_offset + 1) = 0;
+                tables.count(sector[0], sector[1], sector[2], sector[3], predator_count, other_count);
             }
-            else if (predator_view.contains(result.eid))
-            {
-                // predator seen
-                input_neurons(cur_neuron_offset) = 1;
-                input_neurons(cur_neuron_offset + 1) = 0;
-            }
-            else
-            {
-                // non-predator seen
-                input_neurons(cur_neuron_offset) = 0;
-                input_neurons(cur_neuron_offset + 1) = 1;
-            }
-            cur_neuron_offset += 2; // iterate in sets of 2 (predator neuron + nonpredator neuron)
+
+            input_neurons(cur_neuron_offset) = area > 0 ? (float)predator_count / area : 0.f;
+            input_neurons(cur_neuron_offset + 1) = area > 0 ? (float)other_count / area : 0.f;
+            cur_neuron_offset += 2;
         }
     });
 }
 
-
 void GridWorld::Systems::simple_brain_mover(registry & reg)
 {
-    auto simple_brain_view = reg.view<SimpleBrain, SimpleBrainMover, Moveable>();
+    auto simple_brain_view = reg.view<SimpleBrainCache, SimpleBrainMover, Moveable>();
 
-    simple_brain_view.each([](SimpleBrain& brain, SimpleBrainMover& mover, Moveable& moveable)
+    simple_brain_view.each([](SimpleBrainCache& cache, SimpleBrainMover& mover, Moveable& moveable)
     {
         int neuron_offset = mover.neuron_offset;
-        auto& output_neurons = brain.neurons.back();
+        auto& output_neurons = cache.neurons.back();
 
         moveable.x_force += 4 * int(output_neurons(0, neuron_offset));
         moveable.x_force -= 4 * int(output_neurons(0, neuron_offset + 1));
@@ -483,7 +1501,7 @@ void GridWorld::Systems::random_movement(registry & reg)
 {
     auto random_mover_view = reg.view<RandomMover, Moveable, RNG>();
 
-    random_mover_view.each([](EntityId eid, RandomMover, Moveable& moveable, RNG& rng)
+    random_mover_view.each([](EntityId, RandomMover, Moveable& moveable, RNG& rng)
     {
         if (rng() % 2 == 0)
         {
@@ -496,43 +1514,42 @@ void GridWorld::Systems::random_movement(registry & reg)
     });
 }
 
-void GridWorld::Systems::predation(registry & reg)
+void GridWorld::Systems::predation(registry & reg, WorkerPool* pool)
 {
     STickCounter& tickCounter = reg.ctx<STickCounter>();
     SWorld& world = reg.ctx<SWorld>();
 
     auto predator_view = reg.view<Predation, Position, RNG>();
     auto scorable_view = reg.view<Scorable>();
+    auto& strips = predation_strips;
+
+    _DiamondStencil const& stencil = reg.ctx_or_set<_DiamondStencilCache>().prepare(world, 1);
 
-    predator_view.each([&tickCounter, &world, scorable_view](EntityId eid, Predation& predation, Position& position, RNG& rng)
+    auto predate = [&tickCounter, &world, &stencil, scorable_view](Predation& predation, Position& position, RNG& rng)
     {
         if (tickCounter.tick < predation.no_predation_until_tick)
         {
             return;
         }
 
-        std::vector<Scorable*> scorables_found;
-        std::vector<map_lookup_result> nearby_entities;
+        std::array<Scorable*, 5> scorables_found;
+        std::array<map_lookup_result, 5> nearby_entities;
 
-        _get_entities_in_radius(world, position.x, position.y, 1, nearby_entities);
+        int scorables_found_size = _get_entities_in_radius(world, stencil, position.x, position.y, TILE_SCORABLE, nearby_entities.data());
 
-        for (auto result : nearby_entities)
+        for (int i = 0; i < scorables_found_size; i++)
         {
-            if (scorable_view.contains(result.eid))
-            {
-                scorables_found.push_back(&scorable_view.get(result.eid));
-            }
+            scorables_found[i] = &scorable_view.get(nearby_entities[i].eid);
         }
 
-        auto scorables_found_size = scorables_found.size();
         if (scorables_found_size > 0)
         {
             if (predation.predate_all)
             {
                 // Reduce all nearby scorables' scores.
-                for (Scorable* scorable : scorables_found)
+                for (int i = 0; i < scorables_found_size; i++)
                 {
-                    scorable->score -= 1;
+                    scorables_found[i]->score -= 1;
                 }
             }
             else
@@ -544,9 +1561,229 @@ void GridWorld::Systems::predation(registry & reg)
             }
             predation.no_predation_until_tick = tickCounter.tick + predation.ticks_between_predations;
         }
+    };
+
+    if (!strips.split(world, pool, predator_view.size()))
+    {
+        predator_view.each(predate);
+        return;
+    }
+
+    predator_view.each([&world, &strips](EntityId eid, Predation&, Position& position, RNG&)
+    {
+        strips.add(world, eid, position);
     });
+
+    // Predators change the scores of their neighbours, which may lie in the next strip over.
+    // Strips of the same parity never share a neighbour, so the even strips run together, then the odd ones.
+    // Score changes add up the same in any order, so this matches the serial result.
+    for (int parity = 0; parity < 2; parity++)
+    {
+        pool->run(strips.count / 2, [&predate, &strips, &predator_view, parity](size_t task)
+        {
+            for (EntityId eid : strips.entities[task * 2 + parity])
+            {
+                auto [predation, position, rng] = predator_view.get<Predation, Position, RNG>(eid);
+                predate(predation, position, rng);
+            }
+        });
+    }
+}
+
+/*
+Hands out random empty tiles, each one at most once.
+Behaves exactly like taking random elements out of a list of the empty tiles in map order
+(moving the last element into the taken one's place), without building the list.
+The free-cell index is left untouched while tiles are taken, so the list stays as it was at the start;
+call sync_taken_cells once the taken tiles have been filled in.
+Sparse worlds have no such list, and sample random tiles instead.
+Counts the tiles it has handed out itself, so take returns -1 once none are left instead of trusting the stale index.
+*/
+struct _FreeCellSampler
+{
+    SWorld& world;
+    int64_t size;
+    std::unordered_map<int64_t, int64_t> moved_cells;
+    std::vector<int64_t> taken_cells;
+
+    _FreeCellSampler(SWorld& world) : world(world), size(world.free_cell_count) {}
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    int64_t get(int64_t index) const
+    {
+        auto iter = moved_cells.find(index);
+        return iter != moved_cells.end() ? iter->second : world.get_free_cell(index);
+    }
+
+    int64_t take(RNG& rng)
+    {
+        if (size == 0)
+        {
+            return -1;
+        }
+
+        if (world.sparse)
+        {
+            // Tiles are filled in right after being taken, so the map itself tells which ones are still free
+            int64_t cell = world.get_random_free_cell(rng);
+            size--;
+            taken_cells.push_back(cell);
+            return cell;
+        }
+
+        int64_t index = rng() % uint64_t(size);
+        int64_t cell = get(index);
+        moved_cells[index] = get(size - 1);
+        size--;
+
+        taken_cells.push_back(cell);
+        return cell;
+    }
+
+    void sync_taken_cells()
+    {
+        for (int64_t cell : taken_cells)
+        {
+            world.sync_free_cell(cell);
+        }
+    }
+};
+
+thread_local std::vector<uint32_t> mutation_draws; // Declared globally to keep in memory
+
+/*
+Mutates each weight with the given chance, by up to half the strength either way, taking two draws from rng per weight
+(whether it mutates, then by how much). Drawing is inherently serial, so all the draws are taken first,
+leaving the arithmetic on them as a branch-free pass over the contiguous weights that vectorizes.
+*/
+void _mutate_synapses(SynapseMat& synapses, RNG& rng, float chance, float strength)
+{
+    Eigen::Index count = synapses.size();
+    mutation_draws.resize(2 * count);
+    for (uint32_t& draw : mutation_draws)
+    {
+        draw = rng();
+    }
+
+    float* weights = synapses.data();
+    uint32_t const* draws = mutation_draws.data();
+    for (Eigen::Index i = 0; i < count; i++)
+    {
+        bool mutation_occurs = (float)draws[2 * i] / (float)UINT32_MAX <= chance;
+        float mutation_amount = ((float)draws[2 * i + 1] / (float)UINT32_MAX - 0.5f) * strength;
+        weights[i] += std::clamp(mutation_occurs * mutation_amount, -1.f, 1.f);
+    }
+}
+
+// The rows and columns of each of a brain's synapse matrices. Brains can only share storage with equal topologies.
+using _BrainTopology = std::vector<Eigen::Index>;
+
+_BrainTopology _get_topology(SimpleBrain const& brain)
+{
+    _BrainTopology topology;
+    for (SynapseMat const& synapses : brain.synapses)
+    {
+        topology.push_back(synapses.rows());
+        topology.push_back(synapses.cols());
+    }
+    return topology;
+}
+
+bool _matches_topology(SimpleBrain const& brain, _BrainTopology const& topology)
+{
+    if (topology.size() != 2 * brain.synapses.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < brain.synapses.size(); i++)
+    {
+        if (brain.synapses[i].rows() != topology[2 * i] || brain.synapses[i].cols() != topology[2 * i + 1])
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
+/*
+Brains taken from destroyed entities, bucketed by topology, along with their caches.
+Copying a brain into recycled storage of the same topology only copies the values,
+so replacing losers with children does not allocate (or free) any matrices.
+Kept in the registry's context between evolutions, so brains left over from one are reused by the next.
+Snapshots and saved states leave it out, since it holds nothing but storage.
+*/
+struct _BrainRecycler
+{
+    struct Bucket
+    {
+        _BrainTopology topology;
+        std::vector<SimpleBrain> brains;
+    };
+
+    std::vector<Bucket> buckets;
+    std::vector<SimpleBrainCache> caches;
+
+    Bucket* find_bucket(SimpleBrain const& brain)
+    {
+        auto iter = std::find_if(buckets.begin(), buckets.end(), [&brain](Bucket& bucket)
+        {
+            return _matches_topology(brain, bucket.topology);
+        });
+        return iter != buckets.end() ? &*iter : nullptr;
+    }
+
+    void recycle(SimpleBrain&& brain)
+    {
+        Bucket* bucket = find_bucket(brain);
+        if (bucket == nullptr)
+        {
+            bucket = &buckets.emplace_back();
+            bucket->topology = _get_topology(brain);
+        }
+        bucket->brains.push_back(std::move(brain));
+    }
+
+    SimpleBrain& assign_copy(registry& reg, EntityId eid, SimpleBrain const& source)
+    {
+        Bucket* bucket = find_bucket(source);
+        if (bucket == nullptr || bucket->brains.empty())
+        {
+            return reg.assign<SimpleBrain>(eid, source);
+        }
+
+        // copy before assigning, since source may live in the same pool
+        SimpleBrain brain = std::move(bucket->brains.back());
+        bucket->brains.pop_back();
+        brain = source;
+        return reg.assign<SimpleBrain>(eid, std::move(brain));
+    }
+
+    // The cache holds nothing valid until the brain systems fill it in; its neurons start out all ones again.
+    SimpleBrainCache& assign_cache(registry& reg, EntityId eid)
+    {
+        if (caches.empty())
+        {
+            return reg.assign<SimpleBrainCache>(eid);
+        }
+
+        SimpleBrainCache cache = std::move(caches.back());
+        caches.pop_back();
+        for (NeuronMat& layer : cache.neurons)
+        {
+            layer.setOnes();
+        }
+        cache.binary_inputs = false;
+        cache.evaluated = false;
+        cache.quantized = false;
+        return reg.assign<SimpleBrainCache>(eid, std::move(cache));
+    }
+};
+
 void GridWorld::Systems::evolution(registry & reg)
 {
     using namespace Events;
@@ -624,49 +1861,55 @@ void GridWorld::Systems::evolution(registry & reg)
 
         // Perform evolution
         // Kill losers
+        _BrainRecycler& recycled_brains = reg.ctx_or_set<_BrainRecycler>();
         for (EntityId loser : losers)
         {
             if (Position* pos = reg.try_get<Position>(loser))
             {
-                world.set_map_data(pos->x, pos->y, entt::null);
+                world.clear_map_data(pos->x, pos->y);
             }
-            reg.destroy(loser);
-        }
-
-        std::vector<int> available_indicies;
-        for (int i = 0; i < world.map.size(); ++i)
-        {
-            if (world.map[i] == entt::null)
+            if (SimpleBrain* brain = reg.try_get<SimpleBrain>(loser))
+            {
+                recycled_brains.recycle(std::move(*brain));
+            }
+            if (SimpleBrainCache* cache = reg.try_get<SimpleBrainCache>(loser))
             {
-                available_indicies.push_back(i);
+                recycled_brains.caches.push_back(std::move(*cache));
             }
+            reg.destroy(loser);
         }
 
+        _FreeCellSampler available_cells(world);
+
         // Create children from winners
         Event::variant_map new_entities;
         for (EntityId winner : winners)
         {
-            // Only entities with RNG components are "evolvable"
-            if (RNG* parent_rng = reg.try_get<RNG>(winner))
+            // Only entities with RNG components are "evolvable", and children on the map need an empty tile
+            RNG* parent_rng = reg.try_get<RNG>(winner);
+            if (parent_rng && !(available_cells.empty() && reg.has<Position>(winner)))
             {
                 EntityId child_eid = reg.create();
 #pragma warning( suppress: 4996 )
-                reg.stamp(child_eid, reg, winner);
+                reg.stamp(child_eid, reg, winner, entt::exclude<SimpleBrain, SimpleBrainCache>);
+
+                if (SimpleBrain* parent_brain = reg.try_get<SimpleBrain>(winner))
+                {
+                    recycled_brains.assign_copy(reg, child_eid, *parent_brain);
+                }
 
                 RNG& child_rng = reg.get<RNG>(child_eid);
                 child_rng.seed((*parent_rng)());
 
                 if (Position* child_pos = reg.try_get<Position>(child_eid))
                 {
-                    uint32_t available_index = child_rng() % available_indicies.size();
-                    int new_pos_index = available_indicies[available_index];
-                    available_indicies[available_index] = available_indicies.back();
-                    available_indicies.pop_back();
+                    int64_t new_pos_index = available_cells.take(child_rng);
 
                     child_pos->x = world.get_map_index_x(new_pos_index);
                     child_pos->y = world.get_map_index_y(new_pos_index);
                     assert(world.map[new_pos_index] == entt::null);
                     world.map[new_pos_index] = child_eid;
+                    world.tile_classes[new_pos_index] = Util::get_tile_class(reg, child_eid);
                 }
 
                 if (SimpleBrain* child_brain = reg.try_get<SimpleBrain>(child_eid))
@@ -674,20 +1917,12 @@ void GridWorld::Systems::evolution(registry & reg)
                     float chance = child_brain->child_mutation_chance;
                     float strength = child_brain->child_mutation_strength;
 
-                    auto randf = [&child_rng]()
-                    {
-                        return (float)child_rng() / (float)UINT32_MAX;
-                    };
-
                     for (SynapseMat& syn_mat : child_brain->synapses)
                     {
-                        for (int i = 0; i < syn_mat.size(); ++i)
-                        {
-                            bool mutation_occurs = randf() <= chance;
-                            float mutation_amount = (randf() - 0.5f) * strength;
-                            syn_mat(i) += std::clamp(mutation_occurs * mutation_amount, -1.f, 1.f);
-                        }
+                        _mutate_synapses(syn_mat, child_rng, chance, strength);
                     }
+
+                    recycled_brains.assign_cache(reg, child_eid);
                 }
 
                 if (Name* child_name = reg.try_get<Name>(child_eid))
@@ -700,7 +1935,8 @@ void GridWorld::Systems::evolution(registry & reg)
         }
 
         // Create new completely randomized entities
-        for (int i = 0; i < sim_config.evo_new_entity_count; ++i)
+        SimpleBrain const blank_brain;
+        for (int i = 0; i < sim_config.evo_new_entity_count && !available_cells.empty(); ++i)
         {
             EntityId eid = reg.create();
 
@@ -716,7 +1952,7 @@ void GridWorld::Systems::evolution(registry & reg)
                 return (float)rng() / (float)UINT32_MAX;
             };
 
-            auto& brain = reg.assign<SimpleBrain>(eid);
+            auto& brain = recycled_brains.assign_copy(reg, eid, blank_brain);
             brain.child_mutation_chance = 0.5f;
             brain.child_mutation_strength = 0.2f;
 
@@ -728,11 +1964,10 @@ void GridWorld::Systems::evolution(registry & reg)
                 }
             }
 
+            recycled_brains.assign_cache(reg, eid);
+
             auto& pos = reg.assign<Position>(eid);
-            uint32_t available_index = rng() % available_indicies.size();
-            int new_pos_index = available_indicies[available_index];
-            available_indicies[available_index] = available_indicies.back();
-            available_indicies.pop_back();
+            int64_t new_pos_index = available_cells.take(rng);
 
             pos.x = world.get_map_index_x(new_pos_index);
             pos.y = world.get_map_index_y(new_pos_index);
@@ -744,9 +1979,14 @@ void GridWorld::Systems::evolution(registry & reg)
             reg.assign<Moveable>(eid);
             reg.assign<Scorable>(eid);
 
+            world.tile_classes[new_pos_index] = Util::get_tile_class(reg, eid);
+
             new_entities[to_string(eid)] = {};
         }
 
+        available_cells.sync_taken_cells();
+        world.release_empty_chunks();
+
         evo_data_map.emplace("new_entities", std::move(new_entities));
 
         evo_data_map.emplace("evo_period_length", (int)sim_config.evo_ticks_per_evolution);
@@ -776,6 +2016,15 @@ void GridWorld::Systems::Util::rebuild_world(registry & reg)
     {
         auto& position = position_view.get(eid);
 
-        world.set_map_data(position.x, position.y, eid);
+        world.set_map_data(position.x, position.y, eid, get_tile_class(reg, eid));
     }
 }
+
+uint8_t GridWorld::Systems::Util::get_tile_class(registry const& reg, EntityId eid)
+{
+    using namespace Component;
+
+    return TILE_OCCUPIED
+        | TILE_PREDATOR * reg.has<Predation>(eid)
+        | TILE_SCORABLE * reg.has<Scorable>(eid);
+}
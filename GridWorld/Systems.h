@@ -2,26 +2,55 @@
 
 #include "Registry.h"
 
+namespace GridWorld
+{
+    class WorkerPool;
+}
+
 namespace GridWorld::Systems
 {
     namespace Util
     {
         void rebuild_world(registry& reg);
+
+        // Returns the TileClassFlags describing the given entity.
+        uint8_t get_tile_class(registry const& reg, EntityId eid);
+
+        struct BrainPrecisionReport
+        {
+            size_t brain_count = 0;
+            double float_seconds = 0;
+            double quantized_seconds = 0;
+            float max_output_error = 0;
+            size_t changed_moves = 0; // brains whose truncated outputs, which movers act on, differ
+        };
+
+        // Times evaluating copies of every brain repeats times in float and in int8, and compares their outputs.
+        BrainPrecisionReport compare_brain_precision(registry& reg, int repeats);
     }
 
     void tick_increment(registry& reg);
 
-    void movement(registry& reg);
+    // Independent movement trees are resolved concurrently when given a pool.
+    void movement(registry& reg, WorkerPool* pool);
 
+    // Sizes the neurons of every SimpleBrainCache to its brain's layers, ahead of the other brain systems.
+    void simple_brain_prepare(registry& reg);
+
+    // Brains whose inputs are unchanged since their last evaluation keep their neurons as they are.
     void simple_brain_calc(registry& reg);
 
-    void simple_brain_seer(registry& reg);
+    // Large populations are split into horizontal strips of the world when given a pool.
+    void simple_brain_seer(registry& reg, WorkerPool* pool);
+
+    void simple_brain_sector_seer(registry& reg);
 
     void simple_brain_mover(registry& reg);
 
     void random_movement(registry& reg);
 
-    void predation(registry& reg);
+    // Large populations are split into horizontal strips of the world when given a pool.
+    void predation(registry& reg, WorkerPool* pool);
 
     void evolution(registry& reg);
 
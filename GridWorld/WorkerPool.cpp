@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+
+GridWorld::WorkerPool::WorkerPool(size_t thread_count)
+{
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        workers.emplace_back(&WorkerPool::worker_loop, this);
+    }
+}
+
+GridWorld::WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard guard(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+size_t GridWorld::WorkerPool::thread_count() const
+{
+    return workers.size() + 1;
+}
+
+void GridWorld::WorkerPool::run(size_t task_count, task_function const& task)
+{
+    if (workers.empty() || task_count <= 1)
+    {
+        for (size_t i = 0; i < task_count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        // Workers that woke up late for the previous run must leave it before the task is replaced.
+        std::unique_lock lock(mutex);
+        work_finished.wait(lock, [this]() { return active_workers == 0; });
+
+        current_task = &task;
+        current_task_count = task_count;
+        next_task = 0;
+        first_exception = nullptr;
+        ++generation;
+    }
+    work_available.notify_all();
+
+    execute_tasks();
+
+    std::unique_lock lock(mutex);
+    work_finished.wait(lock, [this]() { return active_workers == 0; });
+
+    current_task = nullptr;
+    current_task_count = 0;
+
+    if (first_exception)
+    {
+        std::rethrow_exception(first_exception);
+    }
+}
+
+void GridWorld::WorkerPool::worker_loop()
+{
+    uint64_t seen_generation = 0;
+
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        work_available.wait(lock, [this, seen_generation]() { return stopping || generation != seen_generation; });
+
+        if (stopping)
+        {
+            return;
+        }
+
+        seen_generation = generation;
+        ++active_workers;
+
+        lock.unlock();
+        execute_tasks();
+        lock.lock();
+
+        if (--active_workers == 0)
+        {
+            work_finished.notify_all();
+        }
+    }
+}
+
+void GridWorld::WorkerPool::execute_tasks()
+{
+    // Tasks are claimed one at a time, so a worker that wakes up late simply finds nothing left to do.
+    for (size_t i = next_task++; i < current_task_count; i = next_task++)
+    {
+        try
+        {
+            (*current_task)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard guard(mutex);
+            if (!first_exception)
+            {
+                first_exception = std::current_exception();
+            }
+        }
+    }
+}
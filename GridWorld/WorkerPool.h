@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+namespace GridWorld
+{
+    /*
+    A fixed set of worker threads for splitting a tick's work.
+    The thread calling run always takes part in the work, so a pool of N threads
+    only starts N - 1 workers.
+    */
+    class WorkerPool
+    {
+    public:
+        using task_function = std::function<void(size_t)>;
+
+        explicit WorkerPool(size_t thread_count);
+
+        ~WorkerPool();
+
+        size_t thread_count() const;
+
+        // Runs task(0) to task(task_count - 1) across the pool, and returns once all of them have finished.
+        // If any task throws, the first exception is rethrown here.
+        void run(size_t task_count, task_function const& task);
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable work_finished;
+        bool stopping = false;
+        uint64_t generation = 0;
+        size_t active_workers = 0;
+
+        task_function const* current_task = nullptr;
+        size_t current_task_count = 0;
+        std::atomic<size_t> next_task = 0;
+        std::exception_ptr first_exception;
+
+        void worker_loop();
+
+        void execute_tasks();
+    };
+}
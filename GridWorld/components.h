@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <bitset>
+#include <unordered_map>
+#include <algorithm>
 #include <Eigen/Dense>
 #include "pcg_random.hpp"
 
@@ -19,11 +22,27 @@ static int wrapi(int i, int lower_bound, int upper_bound)
 
 namespace GridWorld::Component
 {
+    // What occupies a tile of the world, as a combination of flags.
+    enum TileClassFlags : uint8_t
+    {
+        TILE_EMPTY = 0,
+        TILE_OCCUPIED = 1,
+        TILE_PREDATOR = 2,
+        TILE_SCORABLE = 4,
+    };
+
     struct SSimulationConfig
     {
         uint32_t evo_ticks_per_evolution = 10000;
         uint32_t evo_winner_count = 6;
         uint32_t evo_new_entity_count = 3;
+
+        /*
+        Evaluates brains with int8 copies of their synapses (see SimpleBrainCache::quantized_synapses).
+        The copies are kept alongside the float synapses, which stay what is saved and inherited, so this trades a
+        quarter more synapse memory for a quarter of the synapse bandwidth while evaluating; it does not save memory.
+        */
+        bool quantized_brains = false;
     };
 
     struct STickCounter
@@ -37,6 +56,55 @@ namespace GridWorld::Component
         int height = 20;
         std::vector<EntityId> map;
 
+        // The TileClassFlags of each tile's entity, kept alongside map so neighbourhoods can be classified
+        // without looking up components.
+        std::vector<uint8_t> tile_classes;
+
+        /*
+        Index of the empty tiles: one bit per tile, plus a Fenwick tree over the bit counts of each word,
+        so the n-th empty tile can be found without scanning the map.
+        Code writing to map directly must call sync_free_cell for every tile it changed.
+        */
+        std::vector<uint64_t> free_bits;
+        std::vector<int64_t> free_word_counts;
+        int64_t free_cell_count = 0;
+
+        // Set by reset_world. When both dimensions are powers of two, coordinates wrap with masks and shifts
+        // instead of divisions; see the PowerOfTwo overloads below.
+        bool power_of_two = false;
+        int width_shift = 0;
+
+        /*
+        If requested, and both dimensions are multiples of 8, map is stored as 8x8 blocks of tiles (row-major within
+        and between blocks) instead of row-major, so a neighbourhood spans few cache lines even on very wide worlds.
+        Map indices then follow the block order; use get_map_index and get_map_index_x/y rather than computing them.
+        */
+        bool use_tiled_layout = false;
+        bool tiled = false; // Set by reset_world
+        int tile_columns = 0;
+        int tile_column_shift = 0;
+
+        /*
+        If requested, map only stores the 64x64 chunks of the world that have been written to, so huge worlds only use
+        memory for the places entities have been. Chunks are allocated from a pool on first write and returned to it
+        by release_empty_chunks once they are empty again; map, tile_classes and free_bits hold the pool, and a map
+        index is a pool slot followed by the tile's position within its chunk.
+        Slot 0 is never allocated and stays empty: reading tiles of unallocated chunks resolves to it, while code that
+        writes to a tile must get its index from get_writable_map_index.
+        The free-cell index only counts empty tiles in sparse worlds; pick empty tiles with get_random_free_cell.
+        */
+        bool use_sparse_layout = false;
+        bool sparse = false; // Set by reset_world
+        static constexpr int chunk_shift = 6;
+        static constexpr int chunk_size = 1 << chunk_shift;
+        static constexpr int chunk_tile_count = chunk_size * chunk_size;
+        static constexpr int64_t no_chunk = -1;
+        std::unordered_map<int64_t, int> chunk_slots;
+        std::vector<int64_t> chunk_keys; // The chunk stored in each slot, or no_chunk
+        std::vector<int> chunk_occupied_counts;
+        std::vector<int> free_chunk_slots;
+        std::vector<int> chunk_release_candidates;
+
         SWorld()
         {
             reset_world();
@@ -46,10 +114,41 @@ namespace GridWorld::Component
         {
             width = p_width;
             height = p_height;
-            map.resize(width * height);
-            for (auto i = 0; i < width * height; i++)
+            power_of_two = width > 0 && height > 0 && (width & (width - 1)) == 0 && (height & (height - 1)) == 0;
+            width_shift = (int)std::bitset<32>(width - 1).count();
+            tiled = use_tiled_layout && width % 8 == 0 && height % 8 == 0;
+            tile_columns = width / 8;
+            tile_column_shift = width_shift - 3;
+
+            sparse = use_sparse_layout;
+            if (sparse)
+            {
+                tiled = false;
+                reset_chunks();
+                return;
+            }
+
+            map.assign(size_t(width) * height, entt::null);
+            tile_classes.assign(map.size(), TILE_EMPTY);
+
+            // Every tile is empty
+            size_t word_count = (map.size() + 63) / 64;
+            free_bits.assign(word_count, UINT64_MAX);
+            if (map.size() % 64 != 0)
+            {
+                free_bits.back() = (uint64_t(1) << (map.size() % 64)) - 1;
+            }
+            free_cell_count = (int64_t)map.size();
+
+            free_word_counts.assign(word_count + 1, 0);
+            for (size_t i = 1; i <= word_count; i++)
             {
-                map[i] = entt::null;
+                free_word_counts[i] += (int64_t)std::bitset<64>(free_bits[i - 1]).count();
+                size_t parent = i + (i & (0 - i));
+                if (parent <= word_count)
+                {
+                    free_word_counts[parent] += free_word_counts[i];
+                }
             }
         }
 
@@ -58,39 +157,443 @@ namespace GridWorld::Component
             reset_world(width, height);
         }
 
+        void reset_chunks()
+        {
+            map.assign(chunk_tile_count, entt::null);
+            tile_classes.assign(chunk_tile_count, TILE_EMPTY);
+            free_bits.assign(chunk_tile_count / 64, UINT64_MAX);
+            free_word_counts.clear();
+            free_cell_count = int64_t(width) * height;
+
+            chunk_slots.clear();
+            chunk_keys.assign(1, no_chunk);
+            chunk_occupied_counts.assign(1, 0);
+            free_chunk_slots.clear();
+            chunk_release_candidates.clear();
+        }
+
+        static int64_t get_chunk_key(int chunk_x, int chunk_y)
+        {
+            return (int64_t(chunk_y) << 32) | uint32_t(chunk_x);
+        }
+
+        // Returns the pool slot of the chunk containing (x, y), allocating it if needed. x and y must be within the map.
+        int get_or_allocate_chunk(int x, int y)
+        {
+            int64_t key = get_chunk_key(x >> chunk_shift, y >> chunk_shift);
+            auto iter = chunk_slots.find(key);
+            if (iter != chunk_slots.end())
+            {
+                return iter->second;
+            }
+
+            int slot;
+            if (!free_chunk_slots.empty())
+            {
+                slot = free_chunk_slots.back();
+                free_chunk_slots.pop_back();
+                chunk_keys[slot] = key;
+            }
+            else
+            {
+                slot = (int)chunk_keys.size();
+                chunk_keys.push_back(key);
+                chunk_occupied_counts.push_back(0);
+                map.resize(map.size() + chunk_tile_count, entt::null);
+                tile_classes.resize(tile_classes.size() + chunk_tile_count, TILE_EMPTY);
+                free_bits.resize(free_bits.size() + chunk_tile_count / 64, UINT64_MAX);
+            }
+
+            chunk_slots.emplace(key, slot);
+            chunk_release_candidates.push_back(slot); // In case nothing is ever placed in it
+            return slot;
+        }
+
+        /*
+        Returns the chunks that became empty to the pool. Map indices into them become invalid,
+        so this must only be called while no one holds on to map indices.
+        */
+        void release_empty_chunks()
+        {
+            for (int slot : chunk_release_candidates)
+            {
+                if (chunk_keys[slot] != no_chunk && chunk_occupied_counts[slot] == 0)
+                {
+                    chunk_slots.erase(chunk_keys[slot]);
+                    chunk_keys[slot] = no_chunk;
+                    free_chunk_slots.push_back(slot);
+                }
+            }
+            chunk_release_candidates.clear();
+        }
+
+        // Updates the free-cell index after map[map_index] was written to directly.
+        void sync_free_cell(int64_t map_index)
+        {
+            uint64_t bit = uint64_t(1) << (map_index % 64);
+            uint64_t& word = free_bits[map_index / 64];
+            bool is_free = map[map_index] == entt::null;
+
+            if (((word & bit) != 0) == is_free)
+            {
+                return;
+            }
+
+            word ^= bit;
+            int delta = is_free ? 1 : -1;
+            free_cell_count += delta;
+
+            if (sparse)
+            {
+                int slot = int(map_index >> (2 * chunk_shift));
+                chunk_occupied_counts[slot] -= delta;
+                if (chunk_occupied_counts[slot] == 0)
+                {
+                    chunk_release_candidates.push_back(slot);
+                }
+                return;
+            }
+
+            for (size_t i = map_index / 64 + 1; i < free_word_counts.size(); i += i & (0 - i))
+            {
+                free_word_counts[i] += delta;
+            }
+        }
+
+        // Returns the map index of the n-th empty tile, counting in map order. Not available in sparse worlds.
+        int64_t get_free_cell(int64_t n) const
+        {
+            size_t word_count = free_bits.size();
+            size_t step = 1;
+            while (step * 2 <= word_count)
+            {
+                step *= 2;
+            }
+
+            size_t word_index = 0;
+            for (; step > 0; step /= 2)
+            {
+                if (word_index + step <= word_count && free_word_counts[word_index + step] <= n)
+                {
+                    word_index += step;
+                    n -= free_word_counts[word_index];
+                }
+            }
+
+            uint64_t word = free_bits[word_index];
+            for (int i = 0; i < n; i++)
+            {
+                word &= word - 1;
+            }
+            int bit_index = (int)std::bitset<64>((word & (0 - word)) - 1).count();
+
+            return int64_t(word_index) * 64 + bit_index;
+        }
+
         EntityId get_map_data(int x, int y) const
         {
             return map[get_map_index(x, y)];
         }
 
-        void set_map_data(int x, int y, EntityId data)
+        uint8_t get_tile_class(int x, int y) const
+        {
+            return tile_classes[get_map_index(x, y)];
+        }
+
+        void set_map_data(int x, int y, EntityId data, uint8_t tile_class)
+        {
+            int64_t map_index = get_writable_map_index(x, y);
+            map[map_index] = data;
+            tile_classes[map_index] = tile_class;
+            sync_free_cell(map_index);
+        }
+
+        void clear_map_data(int x, int y)
+        {
+            // Tiles of unallocated chunks are already clear, so this never needs to allocate one
+            int64_t map_index = get_map_index(x, y);
+            map[map_index] = entt::null;
+            tile_classes[map_index] = TILE_EMPTY;
+            sync_free_cell(map_index);
+        }
+
+        /*
+        Returns the map index of a random empty tile, or -1 if there are none.
+        Dense worlds pick it from the free-cell index; sparse worlds sample random tiles until an empty one is found,
+        allocating its chunk.
+        */
+        template<class Rng>
+        int64_t get_random_free_cell(Rng& rng)
+        {
+            if (free_cell_count == 0)
+            {
+                return -1;
+            }
+
+            if (!sparse)
+            {
+                return get_free_cell(int64_t(rng() % uint64_t(free_cell_count)));
+            }
+
+            while (true)
+            {
+                int x = int(rng() % uint32_t(width));
+                int y = int(rng() % uint32_t(height));
+
+                int64_t map_index = get_map_index(x, y);
+                if (map[map_index] == entt::null)
+                {
+                    return get_writable_map_index(x, y);
+                }
+            }
+        }
+
+        int64_t get_map_index(int x, int y) const
+        {
+            return power_of_two ? get_map_index<true>(x, y) : get_map_index<false>(x, y);
+        }
+
+        int get_map_index_x(int64_t map_index) const
+        {
+            return power_of_two ? get_map_index_x<true>(map_index) : get_map_index_x<false>(map_index);
+        }
+
+        int get_map_index_y(int64_t map_index) const
+        {
+            return power_of_two ? get_map_index_y<true>(map_index) : get_map_index_y<false>(map_index);
+        }
+
+        // Like get_map_index, for coordinates already within the map.
+        int64_t to_map_index(int x, int y) const
         {
-            map[get_map_index(x, y)] = data;
+            return power_of_two ? to_map_index<true>(x, y) : to_map_index<false>(x, y);
         }
 
-        int get_map_index(int x, int y) const
+        int64_t get_writable_map_index(int x, int y)
         {
-            return normalize_y(y) * width + normalize_x(x);
+            return power_of_two ? get_writable_map_index<true>(x, y) : get_writable_map_index<false>(x, y);
         }
 
-        int get_map_index_x(int map_index) const
+        int normalize_x(int x) const
+        {
+            return power_of_two ? normalize_x<true>(x) : normalize_x<false>(x);
+        }
+
+        int normalize_y(int y) const
+        {
+            return power_of_two ? normalize_y<true>(y) : normalize_y<false>(y);
+        }
+
+        /*
+        Overloads for kernels that choose the wrapping method once, outside their loops.
+        PowerOfTwo must only be true if power_of_two is.
+        */
+        template<bool PowerOfTwo>
+        int64_t get_map_index(int x, int y) const
+        {
+            return to_map_index<PowerOfTwo>(normalize_x<PowerOfTwo>(x), normalize_y<PowerOfTwo>(y));
+        }
+
+        // Like get_map_index, but allocates the tile's chunk in sparse worlds so the tile can be written to.
+        template<bool PowerOfTwo>
+        int64_t get_writable_map_index(int x, int y)
+        {
+            if (sparse)
+            {
+                x = normalize_x<PowerOfTwo>(x);
+                y = normalize_y<PowerOfTwo>(y);
+                return to_chunk_map_index(get_or_allocate_chunk(x, y), x, y);
+            }
+
+            return get_map_index<PowerOfTwo>(x, y);
+        }
+
+        template<bool PowerOfTwo>
+        int64_t to_map_index(int x, int y) const
         {
-            return map_index % width;
+            if (tiled)
+            {
+                int block_row = y >> 3;
+                int64_t block = (PowerOfTwo ? int64_t(block_row) << tile_column_shift : int64_t(block_row) * tile_columns) + (x >> 3);
+                return (block << 6) | ((y & 7) << 3) | (x & 7);
+            }
+
+            if (sparse)
+            {
+                auto iter = chunk_slots.find(get_chunk_key(x >> chunk_shift, y >> chunk_shift));
+                return to_chunk_map_index(iter != chunk_slots.end() ? iter->second : 0, x, y);
+            }
+
+            if constexpr (PowerOfTwo)
+            {
+                return (int64_t(y) << width_shift) | x;
+            }
+            else
+            {
+                return int64_t(y) * width + x;
+            }
         }
 
-        int get_map_index_y(int map_index) const
+        template<bool PowerOfTwo>
+        int get_map_index_x(int64_t map_index) const
         {
-            return map_index / width;
+            if (tiled)
+            {
+                int64_t block = map_index >> 6;
+                int block_column = int(PowerOfTwo ? block & (tile_columns - 1) : block % tile_columns);
+                return (block_column << 3) | int(map_index & 7);
+            }
+
+            if (sparse)
+            {
+                int chunk_x = int(uint32_t(chunk_keys[map_index >> (2 * chunk_shift)]));
+                return (chunk_x << chunk_shift) | int(map_index & (chunk_size - 1));
+            }
+
+            if constexpr (PowerOfTwo)
+            {
+                return int(map_index & (width - 1));
+            }
+            else
+            {
+                return int(map_index % width);
+            }
         }
 
+        template<bool PowerOfTwo>
+        int get_map_index_y(int64_t map_index) const
+        {
+            if (tiled)
+            {
+                int64_t block = map_index >> 6;
+                int block_row = int(PowerOfTwo ? block >> tile_column_shift : block / tile_columns);
+                return (block_row << 3) | int((map_index >> 3) & 7);
+            }
+
+            if (sparse)
+            {
+                int chunk_y = int(chunk_keys[map_index >> (2 * chunk_shift)] >> 32);
+                return (chunk_y << chunk_shift) | int((map_index >> chunk_shift) & (chunk_size - 1));
+            }
+
+            if constexpr (PowerOfTwo)
+            {
+                return int(map_index >> width_shift);
+            }
+            else
+            {
+                return int(map_index / width);
+            }
+        }
+
+        template<bool PowerOfTwo>
         int normalize_x(int x) const
         {
-            return wrapi(x, 0, width);
+            if constexpr (PowerOfTwo)
+            {
+                return x & (width - 1);
+            }
+            else
+            {
+                return wrapi(x, 0, width);
+            }
         }
 
+        template<bool PowerOfTwo>
         int normalize_y(int y) const
         {
-            return wrapi(y, 0, height);
+            if constexpr (PowerOfTwo)
+            {
+                return y & (height - 1);
+            }
+            else
+            {
+                return wrapi(y, 0, height);
+            }
+        }
+
+        int64_t to_chunk_map_index(int slot, int x, int y) const
+        {
+            return (int64_t(slot) << (2 * chunk_shift)) | ((y & (chunk_size - 1)) << chunk_shift) | (x & (chunk_size - 1));
+        }
+
+        /*
+        Calls f(x, y, map_data) for every occupied tile in row-major order, whatever the layout of map.
+        Empty tiles are skipped through the free-cell bits, a word at a time, so sparse worlds only visit the chunks
+        they have allocated.
+        */
+        template<class F>
+        void for_each_tile_row_major(F&& f) const
+        {
+            // Visits the tiles whose bits are set, given the map index and position of bit 0, all on one row.
+            auto visit_row = [this, &f](uint64_t occupied, int64_t first_index, int first_x, int y)
+            {
+                for (; occupied != 0; occupied &= occupied - 1)
+                {
+                    int bit = (int)std::bitset<64>((occupied & (0 - occupied)) - 1).count();
+                    f(first_x + bit, y, map[first_index + bit]);
+                }
+            };
+
+            if (sparse)
+            {
+                // Keys order chunks by row, then column
+                std::vector<std::pair<int64_t, int>> chunks(chunk_slots.begin(), chunk_slots.end());
+                std::sort(chunks.begin(), chunks.end());
+
+                for (size_t row_begin = 0, row_end = 0; row_begin < chunks.size(); row_begin = row_end)
+                {
+                    int chunk_y = int(chunks[row_begin].first >> 32);
+                    while (row_end < chunks.size() && int(chunks[row_end].first >> 32) == chunk_y)
+                    {
+                        row_end++;
+                    }
+
+                    // A row of a chunk is exactly one word of free bits
+                    for (int tile_y = 0; tile_y < chunk_size; tile_y++)
+                    {
+                        for (size_t i = row_begin; i < row_end; i++)
+                        {
+                            int64_t first_index = to_chunk_map_index(chunks[i].second, 0, tile_y);
+                            int chunk_x = int(uint32_t(chunks[i].first));
+                            visit_row(~free_bits[first_index / 64], first_index, chunk_x << chunk_shift, (chunk_y << chunk_shift) | tile_y);
+                        }
+                    }
+                }
+                return;
+            }
+
+            if (tiled)
+            {
+                // A row of a block is one byte of the block's word of free bits
+                for (int y = 0; y < height; y++)
+                {
+                    for (int block_x = 0; block_x < tile_columns; block_x++)
+                    {
+                        int64_t first_index = to_map_index<false>(block_x << 3, y);
+                        uint64_t occupied = (~free_bits[first_index / 64] >> (first_index % 64)) & 0xff;
+                        visit_row(occupied, first_index, block_x << 3, y);
+                    }
+                }
+                return;
+            }
+
+            // Row-major already; words can span rows, so each row is cut out of the words it covers
+            for (int y = 0; y < height; y++)
+            {
+                int64_t row_index = int64_t(y) * width;
+                for (int x = 0; x < width; x += 64 - int((row_index + x) % 64))
+                {
+                    int64_t first_index = row_index + x;
+                    int count = std::min(64 - int(first_index % 64), width - x);
+                    uint64_t occupied = ~free_bits[first_index / 64] >> (first_index % 64);
+                    if (count < 64)
+                    {
+                        occupied &= (uint64_t(1) << count) - 1;
+                    }
+                    visit_row(occupied, first_index, x, y);
+                }
+            }
         }
     };
 
@@ -127,19 +630,21 @@ namespace GridWorld::Component
 
     using SynapseMat = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
     using NeuronMat = Eigen::Matrix<float, 1, Eigen::Dynamic>;
+    using QuantizedSynapseMat = Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    /*
+    The heritable part of a brain: its synapses and how its children mutate them.
+    The neurons are evaluated into the brain's SimpleBrainCache, and their layer sizes follow from the synapses:
+    every layer but the last starts with a bias neuron, so layer i has synapses[i].rows() neurons and the last layer
+    has synapses.back().cols().
+    */
     struct SimpleBrain
     {
         std::vector<SynapseMat> synapses;
-        std::vector<NeuronMat> neurons;
         float child_mutation_chance = 0.5f;
         float child_mutation_strength = 0.2f;
 
         SimpleBrain()
         {
-            neurons.push_back(NeuronMat::Ones(27));
-            neurons.push_back(NeuronMat::Ones(9));
-            neurons.push_back(NeuronMat::Ones(4));
-
             synapses.push_back(SynapseMat::Zero(27, 8));
             synapses.push_back(SynapseMat::Zero(9, 4));
         }
@@ -150,20 +655,67 @@ namespace GridWorld::Component
             {
                 int in = neuron_counts[i] + 1;
                 int out = neuron_counts[i + 1];
-                neurons.push_back(NeuronMat::Ones(in));
                 synapses.push_back(SynapseMat::Zero(in, out));
             }
-            // The final neuron count is output only, no bias neuron
-            neurons.push_back(NeuronMat::Ones(neuron_counts[layers - 1]));
+        }
+
+        size_t get_layer_count() const
+        {
+            return synapses.size() + 1;
+        }
+
+        Eigen::Index get_layer_size(size_t layer) const
+        {
+            return layer < synapses.size() ? synapses[layer].rows() : synapses.back().cols();
         }
     };
 
+    /*
+    What the brain systems keep about a SimpleBrain between ticks, none of which is heritable.
+    Never serialized, cloned into snapshots or inherited. Every brain gets one wherever it is assigned or loaded,
+    and anything that changes a SimpleBrain outside of the brain systems must replace its cache with a fresh one.
+    */
+    struct SimpleBrainCache
+    {
+        // Sized to the brain's layers by simple_brain_prepare, starting out all ones. The seers write the inputs,
+        // simple_brain_calc everything after them except the bias neurons, and the movers read the outputs.
+        std::vector<NeuronMat> neurons;
+
+        // While binary_inputs is set, the inputs are all 0 or 1 and held as bits instead of in neurons[0]:
+        // input k is 1 if bit k of input_bits is set. The seer sets it when it sees all inputs but ones that were already 0 or 1.
+        uint64_t input_bits = 0;
+        bool binary_inputs = false;
+
+        // What the neurons were last evaluated from, only valid while evaluated is set: the input bits if the inputs
+        // were binary, or else the (relu'd) inputs.
+        NeuronMat evaluated_inputs;
+        uint64_t evaluated_input_bits = 0;
+        bool evaluated_binary = false;
+        bool evaluated = false;
+
+        // int8 copies of the synapses, each matrix multiplied by its power-of-two scale, only valid while quantized is set.
+        std::vector<QuantizedSynapseMat> quantized_synapses;
+        std::vector<float> synapse_scales;
+        bool quantized = false;
+    };
+
     struct SimpleBrainSeer
     {
         int neuron_offset = 1;
         int sight_radius = 2;
     };
 
+    /*
+    Aggregated vision: instead of one pair of neurons per tile, sees the density of predators and of other entities
+    in each of four rectangular sectors (north, east, south, west) out to sight_radius, as 8 neurons in that order
+    (predator density then non-predator density per sector). Costs the same for any radius.
+    */
+    struct SimpleBrainSectorSeer
+    {
+        int neuron_offset = 1;
+        int sight_radius = 10;
+    };
+
     struct SimpleBrainMover
     {
         int neuron_offset = 0;
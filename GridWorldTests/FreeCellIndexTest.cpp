@@ -0,0 +1,239 @@
+// Randomly fills and clears tiles of SWorld and checks its free-cell index (the free bitmap, the Fenwick
+// tree over its words and the sampling built on top of them) against a brute force scan of the map.
+// Returns the number of failed checks.
+
+#include <cstdint>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+#include <entt/entt.hpp>
+
+#include "components.h"
+
+using namespace GridWorld;
+using namespace GridWorld::Component;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what, int width, int height, int step)
+{
+    if (!condition)
+    {
+        ++failures;
+        std::printf("FAILED: %s (world %dx%d, step %d)\n", what, width, height, step);
+    }
+}
+
+static std::vector<int> brute_force_free_cells(SWorld const& world)
+{
+    std::vector<int> free_cells;
+    for (int i = 0; i < (int)world.map.size(); i++)
+    {
+        if (world.map[i] == entt::null)
+        {
+            free_cells.push_back(i);
+        }
+    }
+    return free_cells;
+}
+
+// The occupied tiles for_each_tile_row_major should visit, found by reading every tile.
+static void check_row_major_tiles(SWorld const& world, int step)
+{
+    std::vector<std::tuple<int, int, EntityId>> expected;
+    for (int y = 0; y < world.height; y++)
+    {
+        for (int x = 0; x < world.width; x++)
+        {
+            if (world.get_map_data(x, y) != entt::null)
+            {
+                expected.emplace_back(x, y, world.get_map_data(x, y));
+            }
+        }
+    }
+
+    std::vector<std::tuple<int, int, EntityId>> visited;
+    world.for_each_tile_row_major([&visited](int x, int y, EntityId eid)
+    {
+        visited.emplace_back(x, y, eid);
+    });
+    check(visited == expected, "for_each_tile_row_major", world.width, world.height, step);
+}
+
+static void check_dense_index(SWorld& world, pcg32& rng, int step)
+{
+    std::vector<int> free_cells = brute_force_free_cells(world);
+    check(world.free_cell_count == (int64_t)free_cells.size(), "free_cell_count", world.width, world.height, step);
+
+    bool bits_match = true;
+    for (int i = 0; i < (int)world.map.size(); i++)
+    {
+        bool bit = (world.free_bits[i / 64] >> (i % 64)) & 1;
+        bits_match &= bit == (world.map[i] == entt::null);
+    }
+    check(bits_match, "free_bits", world.width, world.height, step);
+
+    // Rebuild the Fenwick tree from the brute force counts of each word
+    size_t word_count = world.free_bits.size();
+    std::vector<int64_t> expected_counts(word_count + 1, 0);
+    for (int cell : free_cells)
+    {
+        expected_counts[cell / 64 + 1]++;
+    }
+    for (size_t i = 1; i <= word_count; i++)
+    {
+        size_t parent = i + (i & (0 - i));
+        if (parent <= word_count)
+        {
+            expected_counts[parent] += expected_counts[i];
+        }
+    }
+    check(world.free_word_counts == expected_counts, "free_word_counts", world.width, world.height, step);
+
+    bool cells_match = true;
+    for (int n = 0; n < (int)free_cells.size(); n++)
+    {
+        cells_match &= world.get_free_cell(n) == free_cells[n];
+    }
+    check(cells_match, "get_free_cell", world.width, world.height, step);
+
+    int64_t sampled = world.get_random_free_cell(rng);
+    bool sampled_valid = free_cells.empty()
+        ? sampled == -1
+        : sampled >= 0 && sampled < (int)world.map.size() && world.map[sampled] == entt::null;
+    check(sampled_valid, "get_random_free_cell", world.width, world.height, step);
+
+    check_row_major_tiles(world, step);
+}
+
+static void fuzz_dense_world(int width, int height, bool tiled, pcg32& rng)
+{
+    SWorld world;
+    world.use_tiled_layout = tiled;
+    world.reset_world(width, height);
+
+    int steps = 4 * width * height;
+    for (int step = 0; step < steps; step++)
+    {
+        int x = int(rng() % uint32_t(width));
+        int y = int(rng() % uint32_t(height));
+
+        // Fill more often than clear during the first half, so the world gets close to full before emptying out
+        bool fill = (rng() % 4) < (step < steps / 2 ? 3u : 1u);
+        if (fill)
+        {
+            world.set_map_data(x, y, EntityId(step + 1), TILE_OCCUPIED);
+        }
+        else
+        {
+            world.clear_map_data(x, y);
+        }
+
+        if (step % 7 == 0)
+        {
+            check_dense_index(world, rng, step);
+        }
+    }
+
+    // Fill every tile, then clear them all
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            world.set_map_data(x, y, EntityId(1), TILE_OCCUPIED);
+        }
+    }
+    check_dense_index(world, rng, steps);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            world.clear_map_data(x, y);
+        }
+    }
+    check_dense_index(world, rng, steps + 1);
+}
+
+static void fuzz_sparse_world(int width, int height, pcg32& rng)
+{
+    SWorld world;
+    world.use_sparse_layout = true;
+    world.reset_world(width, height);
+
+    std::vector<bool> occupied(size_t(width) * height, false);
+    int64_t occupied_count = 0;
+
+    int steps = 20000;
+    for (int step = 0; step < steps; step++)
+    {
+        int x = int(rng() % uint32_t(width));
+        int y = int(rng() % uint32_t(height));
+        size_t tile = size_t(y) * width + x;
+
+        if (rng() % 3 != 0)
+        {
+            occupied_count += !occupied[tile];
+            occupied[tile] = true;
+            world.set_map_data(x, y, EntityId(step + 1), TILE_OCCUPIED);
+        }
+        else
+        {
+            occupied_count -= occupied[tile];
+            occupied[tile] = false;
+            world.clear_map_data(x, y);
+        }
+
+        if (step % 97 == 0)
+        {
+            world.release_empty_chunks();
+
+            check(world.free_cell_count == int64_t(width) * height - occupied_count, "sparse free_cell_count", width, height, step);
+
+            int64_t sampled = world.get_random_free_cell(rng);
+            check(sampled >= 0 && world.map[sampled] == entt::null, "sparse get_random_free_cell", width, height, step);
+        }
+    }
+
+    check_row_major_tiles(world, steps);
+}
+
+// Map indices of chunks in slots past 2^19 no longer fit in an int; check they still round-trip to coordinates.
+static void check_sparse_indices_past_int_range()
+{
+    SWorld world;
+    world.use_sparse_layout = true;
+    world.reset_world(100000, 100000);
+
+    // Pretend the pool already holds enough chunks, without allocating their tiles
+    int slot = (1 << 19) + 3;
+    int x = 99999, y = 54321;
+    world.chunk_keys.resize(slot + 1, SWorld::no_chunk);
+    world.chunk_keys[slot] = SWorld::get_chunk_key(x >> SWorld::chunk_shift, y >> SWorld::chunk_shift);
+    world.chunk_slots.emplace(world.chunk_keys[slot], slot);
+
+    int64_t map_index = world.get_map_index(x, y);
+    check(map_index > INT32_MAX, "sparse map index range", world.width, world.height, 0);
+    check(world.get_map_index_x(map_index) == x && world.get_map_index_y(map_index) == y, "sparse map index round trip",
+        world.width, world.height, 0);
+}
+
+int run_free_cell_index_tests()
+{
+    pcg32 rng(12345);
+
+    // Sizes around word boundaries, powers of two and worlds eligible for the tiled layout
+    const int sizes[][2] = { { 1, 1 }, { 7, 9 }, { 8, 8 }, { 13, 5 }, { 64, 1 }, { 65, 3 }, { 20, 20 }, { 32, 64 }, { 40, 24 }, { 100, 37 } };
+    for (auto const& size : sizes)
+    {
+        fuzz_dense_world(size[0], size[1], false, rng);
+        fuzz_dense_world(size[0], size[1], true, rng);
+    }
+
+    fuzz_sparse_world(300, 200, rng);
+    fuzz_sparse_world(4096, 4096, rng);
+    check_sparse_indices_past_int_range();
+
+    std::printf(failures == 0 ? "All free-cell index checks passed.\n" : "%d free-cell index checks failed.\n", failures);
+    return failures;
+}
@@ -0,0 +1,17 @@
+// Runs every GridWorld test. Returns the total number of failed checks, so any nonzero exit code is a failure.
+
+#include <cstdio>
+
+int run_free_cell_index_tests();
+
+int run_movement_resolver_tests();
+
+int main()
+{
+    int failures = 0;
+    failures += run_free_cell_index_tests();
+    failures += run_movement_resolver_tests();
+
+    std::printf(failures == 0 ? "All tests passed.\n" : "%d checks failed.\n", failures);
+    return failures;
+}
@@ -0,0 +1,468 @@
+// Runs Systems::movement on random force fields and occupancies, serially and on a worker pool, and checks the
+// resulting positions and map against the original resolver, which found entry nodes by walking up the parents
+// of every added node. Returns the number of failed checks.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <queue>
+#include <set>
+#include <algorithm>
+#include <entt/entt.hpp>
+
+#include "components.h"
+#include "Systems.h"
+#include "WorkerPool.h"
+
+using namespace GridWorld;
+using namespace GridWorld::Component;
+
+static int failures = 0;
+
+#pragma region Parent Walk Resolver
+/*
+The resolver as it was before movement moved onto flat per-tile arrays, on a plain row-major map of wrapped
+coordinates, so it does not share any code with the one under test.
+*/
+struct _ReferenceNode
+{
+    int map_index = -1;
+    std::vector<_ReferenceNode*> child_nodes;
+    _ReferenceNode* parent_node = nullptr;
+    bool is_entry_node = false;
+    int entity = -1;
+    int net_force = 0;
+    bool finalized = false;
+    _ReferenceNode* accepted_child = nullptr;
+};
+
+struct _ReferenceMover
+{
+    int x;
+    int y;
+    int x_force;
+    int y_force;
+};
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+class _ReferenceResolver
+{
+public:
+    _ReferenceResolver(int p_width, int p_height, std::vector<int>& p_map, std::vector<_ReferenceMover>& p_movers)
+        : width(p_width), height(p_height), map(p_map), movers(p_movers), nodes(p_map.size())
+    {
+    }
+
+    // Moves movers in the given order, the order the registry view adds them to the graph.
+    void run(std::vector<int> const& order)
+    {
+        for (int entity : order)
+        {
+            add_movement_info(entity);
+        }
+
+        for (auto* entry_node : entry_nodes)
+        {
+            traverse_and_resolve_movement(*entry_node);
+        }
+
+        for (auto* entry_node : entry_nodes)
+        {
+            traverse_and_execute_movement(*entry_node);
+        }
+    }
+private:
+    int width;
+    int height;
+    std::vector<int>& map;
+    std::vector<_ReferenceMover>& movers;
+    std::vector<_ReferenceNode> nodes;
+    std::set<_ReferenceNode*> entry_nodes;
+
+    int get_map_index(int x, int y) const
+    {
+        x = ((x % width) + width) % width;
+        y = ((y % height) + height) % height;
+        return y * width + x;
+    }
+
+    _ReferenceNode* get_node(int map_index)
+    {
+        auto* node = &nodes[map_index];
+        if (node->map_index == -1)
+        {
+            node->map_index = map_index;
+            node->entity = map[map_index];
+        }
+        return node;
+    }
+
+    void set_entry_node(_ReferenceNode* node, bool is_entry_node)
+    {
+        if (node->is_entry_node != is_entry_node)
+        {
+            node->is_entry_node = is_entry_node;
+            if (is_entry_node)
+            {
+                entry_nodes.insert(node);
+            }
+            else
+            {
+                entry_nodes.erase(node);
+            }
+        }
+    }
+
+    void add_movement_info(int entity)
+    {
+        auto& mover = movers[entity];
+
+        int abs_x_force = abs(mover.x_force);
+        int abs_y_force = abs(mover.y_force);
+
+        if (abs_x_force - abs_y_force == 0)
+        {
+            return;
+        }
+
+        int cancellation = std::min(abs_x_force, abs_y_force);
+
+        int true_x_force = (abs_x_force - cancellation) * sign(mover.x_force);
+        int true_y_force = (abs_y_force - cancellation) * sign(mover.y_force);
+
+        int new_x = mover.x;
+        int new_y = mover.y;
+        int net_force = 0;
+        if (true_x_force > 0)
+        {
+            new_x += 1;
+            net_force = true_x_force;
+        }
+        else if (true_x_force < 0)
+        {
+            new_x -= 1;
+            net_force = -true_x_force;
+        }
+        else if (true_y_force > 0)
+        {
+            new_y += 1;
+            net_force = true_y_force;
+        }
+        else
+        {
+            new_y -= 1;
+            net_force = -true_y_force;
+        }
+
+        bool new_node_existed = nodes[get_map_index(new_x, new_y)].map_index != -1;
+        auto* cur_node = get_node(get_map_index(mover.x, mover.y));
+        auto* new_node = get_node(get_map_index(new_x, new_y));
+        if (!new_node_existed)
+        {
+            set_entry_node(new_node, true);
+        }
+
+        cur_node->net_force = net_force;
+
+        if (cur_node->parent_node != new_node)
+        {
+            if (cur_node->parent_node != nullptr)
+            {
+                auto& parent_children = cur_node->parent_node->child_nodes;
+                parent_children.erase(std::remove(parent_children.begin(), parent_children.end(), cur_node), parent_children.end());
+            }
+
+            cur_node->parent_node = new_node;
+            new_node->child_nodes.push_back(cur_node);
+        }
+
+        // Search for an entry node among our parents
+        auto* search_node = cur_node->parent_node;
+        while (!search_node->is_entry_node && search_node != cur_node)
+        {
+            search_node = search_node->parent_node;
+        }
+
+        if (search_node != cur_node && cur_node->is_entry_node)
+        {
+            set_entry_node(cur_node, false);
+        }
+        else if (search_node == cur_node && !cur_node->is_entry_node)
+        {
+            // A loop without an entry node
+            set_entry_node(cur_node, true);
+        }
+    }
+
+    static _ReferenceNode* accept_most_forceful_child(_ReferenceNode& node, std::queue<_ReferenceNode*>& traversal_queue)
+    {
+        int highest_force = -1;
+        _ReferenceNode* highest_child = nullptr;
+
+        for (auto* child : node.child_nodes)
+        {
+            if (child->net_force > highest_force)
+            {
+                highest_child = child;
+                highest_force = child->net_force;
+            }
+            else if (child->net_force == highest_force)
+            {
+                highest_child = nullptr;
+            }
+
+            traversal_queue.push(child);
+        }
+
+        return highest_child;
+    }
+
+    void traverse_and_resolve_movement(_ReferenceNode& entry_node)
+    {
+        std::queue<_ReferenceNode*> traversal_queue;
+
+        if (entry_node.parent_node != nullptr)
+        {
+            // Cycle: every node of the cycle moves
+            auto* previous_cycle_node = &entry_node;
+            auto* current_cycle_node = entry_node.parent_node;
+
+            while (!current_cycle_node->finalized)
+            {
+                current_cycle_node->accepted_child = previous_cycle_node;
+                current_cycle_node->finalized = true;
+
+                for (auto* child : current_cycle_node->child_nodes)
+                {
+                    if (child != previous_cycle_node)
+                    {
+                        traversal_queue.push(child);
+                    }
+                }
+
+                previous_cycle_node = current_cycle_node;
+                current_cycle_node = current_cycle_node->parent_node;
+            }
+        }
+        else if (entry_node.entity != -1)
+        {
+            // Entity that is not moving: reject all children
+            entry_node.finalized = true;
+
+            for (auto* child : entry_node.child_nodes)
+            {
+                traversal_queue.push(child);
+            }
+        }
+        else
+        {
+            entry_node.accepted_child = accept_most_forceful_child(entry_node, traversal_queue);
+            entry_node.finalized = true;
+        }
+
+        while (!traversal_queue.empty())
+        {
+            auto* cur_node = traversal_queue.front();
+            traversal_queue.pop();
+
+            if (cur_node->parent_node->accepted_child == cur_node)
+            {
+                cur_node->accepted_child = accept_most_forceful_child(*cur_node, traversal_queue);
+            }
+            else
+            {
+                for (auto* child : cur_node->child_nodes)
+                {
+                    traversal_queue.push(child);
+                }
+            }
+            cur_node->finalized = true;
+        }
+    }
+
+    void traverse_and_execute_movement(_ReferenceNode& entry_node)
+    {
+        auto* cur_node = &entry_node;
+        int cur_map_index = cur_node->map_index;
+
+        while (cur_node->accepted_child != nullptr && map[cur_map_index] != cur_node->accepted_child->entity)
+        {
+            map[cur_map_index] = cur_node->accepted_child->entity;
+            movers[cur_node->accepted_child->entity].x = cur_map_index % width;
+            movers[cur_node->accepted_child->entity].y = cur_map_index / width;
+
+            cur_node = cur_node->accepted_child;
+            cur_map_index = cur_node->map_index;
+        }
+
+        // The last node of a tree that moved was not iterated over, so clear its tile
+        if (cur_node->accepted_child == nullptr && cur_node != &entry_node)
+        {
+            map[cur_map_index] = -1;
+        }
+    }
+};
+#pragma endregion Parent Walk Resolver
+
+enum class ForceField
+{
+    Random,     // Small random forces, with many ties and cancellations
+    Conveyor,   // Every row pushes the same way, so full rows wrap around into cycles
+    Converging, // Everything pushes towards the centre, so many children compete for each tile
+};
+
+struct MovementCase
+{
+    int width;
+    int height;
+    bool tiled;
+    bool sparse;
+    int occupancy_percent;
+    ForceField field;
+};
+
+static void pick_forces(MovementCase const& test_case, int x, int y, pcg32& rng, int& x_force, int& y_force)
+{
+    switch (test_case.field)
+    {
+    case ForceField::Random:
+        x_force = int(rng() % 7) - 3;
+        y_force = int(rng() % 7) - 3;
+        break;
+    case ForceField::Conveyor:
+        x_force = (y % 2 == 0 ? 1 : -1) * int(1 + rng() % 2);
+        y_force = rng() % 8 == 0 ? int(rng() % 5) - 2 : 0;
+        break;
+    case ForceField::Converging:
+        x_force = sign(test_case.width / 2 - x) * int(1 + rng() % 3);
+        y_force = sign(test_case.height / 2 - y) * int(1 + rng() % 3);
+        break;
+    }
+}
+
+static void run_movement_case(MovementCase const& test_case, WorkerPool* pool, pcg32& rng)
+{
+    registry reg;
+    auto& world = reg.set<SWorld>();
+    world.use_tiled_layout = test_case.tiled;
+    world.use_sparse_layout = test_case.sparse;
+    world.reset_world(test_case.width, test_case.height);
+
+    std::vector<int> reference_map(size_t(test_case.width) * test_case.height, -1);
+    std::vector<_ReferenceMover> reference_movers;
+    std::vector<EntityId> entities;
+
+    for (int y = 0; y < test_case.height; y++)
+    {
+        for (int x = 0; x < test_case.width; x++)
+        {
+            if (int(rng() % 100) >= test_case.occupancy_percent)
+            {
+                continue;
+            }
+
+            _ReferenceMover mover = { x, y, 0, 0 };
+            pick_forces(test_case, x, y, rng, mover.x_force, mover.y_force);
+
+            EntityId eid = reg.create();
+            reg.assign<Position>(eid, x, y);
+            // Some entities stay put without a Moveable, and only block the tiles they are on
+            if (rng() % 16 != 0)
+            {
+                reg.assign<Moveable>(eid, mover.x_force, mover.y_force);
+            }
+            else
+            {
+                mover.x_force = mover.y_force = 0;
+            }
+            world.set_map_data(x, y, eid, TILE_OCCUPIED);
+
+            reference_map[size_t(y) * test_case.width + x] = (int)entities.size();
+            reference_movers.push_back(mover);
+            entities.push_back(eid);
+        }
+    }
+
+    // Add the movers to the reference graph in the order movement will see them
+    std::vector<int> entity_indices(entities.size() + 1, -1);
+    for (size_t i = 0; i < entities.size(); i++)
+    {
+        entity_indices[to_integral(reg.entity(entities[i]))] = (int)i;
+    }
+
+    std::vector<int> order;
+    reg.view<Moveable, Position>().each([&reg, &order, &entity_indices](EntityId eid, Moveable&, Position&)
+    {
+        order.push_back(entity_indices[to_integral(reg.entity(eid))]);
+    });
+
+    _ReferenceResolver(test_case.width, test_case.height, reference_map, reference_movers).run(order);
+    Systems::movement(reg, pool);
+
+    bool positions_match = true;
+    for (size_t i = 0; i < entities.size(); i++)
+    {
+        auto& position = reg.get<Position>(entities[i]);
+        positions_match &= position.x == reference_movers[i].x && position.y == reference_movers[i].y;
+    }
+
+    bool map_matches = true;
+    for (int y = 0; y < test_case.height; y++)
+    {
+        for (int x = 0; x < test_case.width; x++)
+        {
+            int entity = reference_map[size_t(y) * test_case.width + x];
+            map_matches &= world.get_map_data(x, y) == (entity == -1 ? EntityId(entt::null) : entities[entity]);
+        }
+    }
+
+    bool free_cells_match = world.free_cell_count == int64_t(test_case.width) * test_case.height - (int64_t)entities.size();
+
+    if (!positions_match || !map_matches || !free_cells_match)
+    {
+        ++failures;
+        std::printf("FAILED: movement (world %dx%d%s%s, %d%% occupied, field %d, %s)%s%s%s\n",
+            test_case.width, test_case.height, test_case.tiled ? " tiled" : "", test_case.sparse ? " sparse" : "",
+            test_case.occupancy_percent, (int)test_case.field, pool != nullptr ? "pool" : "serial",
+            positions_match ? "" : " positions", map_matches ? "" : " map", free_cells_match ? "" : " free cells");
+    }
+}
+
+int run_movement_resolver_tests()
+{
+    pcg32 rng(54321);
+    WorkerPool pool(4);
+
+    // 128x128 and larger at high occupancy give enough entry nodes for the pool to resolve trees concurrently
+    const MovementCase cases[] = {
+        { 1, 1, false, false, 100, ForceField::Random },
+        { 2, 1, false, false, 100, ForceField::Conveyor },
+        { 7, 9, false, false, 60, ForceField::Random },
+        { 13, 5, false, false, 100, ForceField::Conveyor },
+        { 20, 20, false, false, 30, ForceField::Converging },
+        { 64, 64, true, false, 80, ForceField::Random },
+        { 100, 37, false, false, 95, ForceField::Conveyor },
+        { 128, 128, false, false, 50, ForceField::Random },
+        { 128, 128, false, false, 90, ForceField::Random },
+        { 128, 128, true, false, 98, ForceField::Conveyor },
+        { 200, 150, false, false, 70, ForceField::Converging },
+        { 256, 64, false, true, 85, ForceField::Random },
+        { 300, 200, false, false, 100, ForceField::Conveyor },
+    };
+
+    for (int round = 0; round < 8; round++)
+    {
+        for (auto const& test_case : cases)
+        {
+            run_movement_case(test_case, nullptr, rng);
+            run_movement_case(test_case, &pool, rng);
+        }
+    }
+
+    std::printf(failures == 0 ? "All movement resolver checks passed.\n" : "%d movement resolver checks failed.\n", failures);
+    return failures;
+}